@@ -0,0 +1,107 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <utility>
+
+static size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+RangeAllocator::RangeAllocator(size_t capacity) : free_size(capacity) {
+  if (capacity > 0)
+    free_ranges.emplace(0, capacity);
+}
+
+std::optional<size_t> RangeAllocator::allocate(size_t size, size_t alignment) {
+  // best fit, counting the padding alignment costs
+  auto best{free_ranges.end()};
+  size_t best_size{0};
+  for (auto range{free_ranges.begin()}; range != free_ranges.end(); ++range) {
+    auto [offset, range_size]{*range};
+    auto padding{align_up(offset, alignment) - offset};
+    if (padding + size > range_size)
+      continue;
+    if (best == free_ranges.end() || range_size < best_size) {
+      best = range;
+      best_size = range_size;
+    }
+  }
+  if (best == free_ranges.end())
+    return std::nullopt;
+
+  // padding before and space after the allocation stay free
+  auto [range_offset, range_size]{*best};
+  auto offset{align_up(range_offset, alignment)};
+  free_ranges.erase(best);
+  if (offset > range_offset)
+    free_ranges.emplace(range_offset, offset - range_offset);
+  if (offset + size < range_offset + range_size)
+    free_ranges.emplace(
+        offset + size,
+        range_offset + range_size - offset - size
+    );
+
+  free_size -= size;
+  return offset;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+  free_size += size;
+  auto range{free_ranges.emplace(offset, size).first};
+
+  // merge with the following and preceding free ranges
+  auto next{std::next(range)};
+  if (next != free_ranges.end() &&
+      range->first + range->second == next->first) {
+    range->second += next->second;
+    free_ranges.erase(next);
+  }
+  if (range != free_ranges.begin()) {
+    auto previous{std::prev(range)};
+    if (previous->first + previous->second == range->first) {
+      previous->second += range->second;
+      free_ranges.erase(range);
+    }
+  }
+}
+
+ArenaBlock::ArenaBlock(BufferArena &arena, size_t offset, size_t size)
+    : arena(&arena), start(offset), length(size) {}
+
+ArenaBlock::ArenaBlock(ArenaBlock &&other) noexcept
+    : arena(std::exchange(other.arena, nullptr)), start(other.start),
+      length(other.length) {}
+
+ArenaBlock::~ArenaBlock() {
+  if (arena)
+    arena->allocator.free(start, length);
+}
+
+ArenaBlock &ArenaBlock::operator=(ArenaBlock &&other) noexcept {
+  // release this object's range
+  if (arena)
+    arena->allocator.free(start, length);
+
+  // move the range out of other into this
+  arena = std::exchange(other.arena, nullptr);
+  start = other.start;
+  length = other.length;
+
+  return *this;
+}
+
+GLuint ArenaBlock::buffer() const { return arena ? GLuint{arena->storage} : 0; }
+
+BufferArena::BufferArena(size_t capacity)
+    : allocator(capacity), capacity(capacity) {
+  storage.allocate_storage(nullptr, capacity, 0);
+}
+
+ArenaBlock BufferArena::allocate(size_t size, size_t alignment) {
+  // empty blocks still get a distinct offset
+  size = std::max<size_t>(size, 1);
+  auto offset{allocator.allocate(size, alignment)};
+  if (!offset)
+    throw ArenaFullError(capacity, size);
+  return ArenaBlock{*this, *offset, size};
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <format>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "gl.h"
+
+class ArenaFullError : public std::runtime_error {
+public:
+  ArenaFullError(size_t capacity, size_t size)
+      : std::runtime_error(std::format(
+            "Buffer arena of {} bytes has no free range of {} bytes",
+            capacity,
+            size
+        )) {}
+};
+
+// Free-list suballocator of byte ranges
+// Free ranges are kept by offset and merged with their neighbours when
+// released, allocations take the smallest free range they fit in.
+class RangeAllocator {
+  std::map<size_t, size_t> free_ranges;
+  size_t free_size;
+
+public:
+  explicit RangeAllocator(size_t capacity);
+
+  // returns an offset that is a multiple of `alignment`, which need not be a
+  // power of two, or nothing when no free range fits
+  std::optional<size_t> allocate(size_t size, size_t alignment);
+
+  // releases a range returned by allocate()
+  void free(size_t offset, size_t size);
+
+  size_t free_bytes() const { return free_size; }
+};
+
+class BufferArena;
+
+// Range of a BufferArena, released back to it on destruction
+class ArenaBlock {
+  BufferArena *arena{nullptr};
+  size_t start{0};
+  size_t length{0};
+
+public:
+  ArenaBlock() = default;
+  ArenaBlock(BufferArena &arena, size_t offset, size_t size);
+  ArenaBlock(const ArenaBlock &) = delete;
+  ArenaBlock(ArenaBlock &&other) noexcept;
+  ~ArenaBlock();
+
+  ArenaBlock &operator=(const ArenaBlock &) = delete;
+  ArenaBlock &operator=(ArenaBlock &&other) noexcept;
+
+  // buffer the block is part of
+  GLuint buffer() const;
+  // from the start of the buffer
+  size_t offset() const { return start; }
+  size_t size() const { return length; }
+};
+
+// Large immutable buffer shared by many users, each owning ranges of it
+// Users bind the one buffer at their offsets instead of owning buffers, so
+// draws of different users need no buffer switches. The storage takes no
+// client updates, blocks are filled by buffer copies. Only the GL thread may
+// allocate or release blocks.
+class BufferArena {
+  gl::Buffer storage;
+  RangeAllocator allocator;
+  size_t capacity;
+
+  friend class ArenaBlock;
+
+public:
+  explicit BufferArena(size_t capacity);
+  BufferArena(const BufferArena &) = delete;
+
+  BufferArena &operator=(const BufferArena &) = delete;
+
+  // Throws ArenaFullError when no free range fits
+  ArenaBlock allocate(size_t size, size_t alignment);
+
+  const gl::Buffer &buffer() const { return storage; }
+  size_t free_bytes() const { return allocator.free_bytes(); }
+};
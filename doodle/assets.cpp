@@ -0,0 +1,40 @@
+#include "assets.h"
+
+#include <algorithm>
+#include <ranges>
+
+namespace fs = std::filesystem;
+
+AssetLibrary::AssetLibrary(bool loose_overrides)
+    : loose_overrides(loose_overrides) {}
+
+void AssetLibrary::mount(const fs::path &path) { packs.emplace_back(path); }
+
+bool AssetLibrary::use_loose(std::string_view name) const {
+  return (loose_overrides || packs.empty()) && fs::exists(fs::path{name});
+}
+
+bool AssetLibrary::contains(std::string_view name) const {
+  if (use_loose(name))
+    return true;
+  return std::ranges::any_of(packs, [&](const Pack &pack) {
+    return pack.find(name).has_value();
+  });
+}
+
+Asset AssetLibrary::open(std::string_view name) const {
+  if (use_loose(name))
+    return Asset{MappedFile{fs::path{name}}};
+
+  for (const auto &pack : packs | std::views::reverse) {
+    if (auto asset{pack.find(name)})
+      return std::move(*asset);
+  }
+  throw AssetNotFoundError(name);
+}
+
+std::string AssetLibrary::read_text(std::string_view name) const {
+  if (use_loose(name))
+    return read_file(fs::path{name});
+  return std::string{open(name).text()};
+}
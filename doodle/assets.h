@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "file.h"
+#include "pack.h"
+
+class AssetNotFoundError : public std::runtime_error {
+public:
+  explicit AssetNotFoundError(std::string_view name)
+      : std::runtime_error(std::format("Asset not found: {}", name)) {}
+};
+
+// Resolves asset names to their bytes
+// Names are looked up in the mounted packs, the most recently mounted first.
+// With loose overrides a file of that name in the working directory wins, so
+// assets can be edited without rebuilding the pack; without them a lookup
+// costs no syscalls. Loose files are always used while no pack is mounted.
+// Lookups are safe from any thread once mounting is done.
+class AssetLibrary {
+  std::vector<Pack> packs;
+  bool loose_overrides;
+
+  bool use_loose(std::string_view name) const;
+
+public:
+  explicit AssetLibrary(bool loose_overrides = true);
+
+  void mount(const std::filesystem::path &path);
+
+  bool contains(std::string_view name) const;
+
+  // Throws AssetNotFoundError when neither a pack nor the disk has the asset
+  Asset open(std::string_view name) const;
+
+  // Same as above, copying the contents; loose files are read instead of
+  // mapped, so they can be saved in place while the copy is in use
+  std::string read_text(std::string_view name) const;
+};
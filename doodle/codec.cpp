@@ -0,0 +1,405 @@
+#include "codec.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mesh.h"
+
+using Group = std::array<uint8_t, codec::group_size>;
+
+// packed bytes per group for each 2-bit width code
+constexpr std::array<size_t, 4> group_bytes{0, 4, 8, 16};
+
+static uint8_t zigzag8(uint8_t delta) {
+  auto value{static_cast<int8_t>(delta)};
+  return static_cast<uint8_t>((value << 1) ^ (value >> 7));
+}
+
+// zigzag over the low `bits` bits of a difference, wrapping like the index
+// type does
+static uint32_t zigzag(uint32_t delta, unsigned bits) {
+  auto shift{32 - bits};
+  auto value{static_cast<int32_t>(delta << shift) >> shift};
+  auto mask{bits == 32 ? 0xffffffffu : (1u << bits) - 1};
+  auto zigzagged{
+      static_cast<uint32_t>(value) << 1 ^ static_cast<uint32_t>(value >> 31)
+  };
+  return zigzagged & mask;
+}
+
+static uint32_t unzigzag(uint32_t value) {
+  return (value >> 1) ^ (0u - (value & 1));
+}
+
+static int width_code(const Group &group) {
+  auto max{*std::ranges::max_element(group)};
+  if (max == 0)
+    return 0;
+  if (max < 4)
+    return 1;
+  if (max < 16)
+    return 2;
+  return 3;
+}
+
+static void
+pack_group(std::vector<std::byte> &out, const Group &group, int code) {
+  switch (code) {
+  case 1:
+    for (size_t byte{0}; byte < 4; ++byte) {
+      out.push_back(static_cast<std::byte>(
+          group[byte * 4] << 6 | group[byte * 4 + 1] << 4 |
+          group[byte * 4 + 2] << 2 | group[byte * 4 + 3]
+      ));
+    }
+    break;
+  case 2:
+    for (size_t byte{0}; byte < 8; ++byte) {
+      out.push_back(
+          static_cast<std::byte>(group[byte * 2] << 4 | group[byte * 2 + 1])
+      );
+    }
+    break;
+  case 3:
+    for (auto value : group)
+      out.push_back(static_cast<std::byte>(value));
+    break;
+  default:
+    break;
+  }
+}
+
+// Appends one lane, groups of four share a header byte so the decoder reads
+// the stream front to back
+static void
+encode_lane(std::vector<std::byte> &out, std::span<const uint8_t> lane) {
+  auto group_count{(lane.size() + codec::group_size - 1) / codec::group_size};
+  for (size_t first_group{0}; first_group < group_count; first_group += 4) {
+    auto header_offset{out.size()};
+    out.push_back(std::byte{0});
+
+    uint8_t header{0};
+    for (size_t group_idx{first_group};
+         group_idx < std::min(group_count, first_group + 4);
+         ++group_idx) {
+      // a partial last group is padded with zeros
+      Group group{};
+      auto begin{group_idx * codec::group_size};
+      auto end{std::min(lane.size(), begin + codec::group_size)};
+      std::copy(lane.begin() + begin, lane.begin() + end, group.begin());
+
+      auto code{width_code(group)};
+      header |= static_cast<uint8_t>(code << ((group_idx - first_group) * 2));
+      pack_group(out, group, code);
+    }
+    out[header_offset] = static_cast<std::byte>(header);
+  }
+}
+
+class StreamReader {
+  std::span<const std::byte> data;
+  size_t position{0};
+
+public:
+  explicit StreamReader(std::span<const std::byte> data) : data(data) {}
+
+  const std::byte *take(size_t size) {
+    if (size > data.size() - position)
+      throw CodecError("truncated");
+    auto begin{data.data() + position};
+    position += size;
+    return begin;
+  }
+
+  bool finished() const { return position == data.size(); }
+};
+
+#if defined(__SSE2__)
+// interleaves the high and low `bits` of every byte, doubling the values
+static __m128i split_fields(__m128i packed, int bits) {
+  auto mask{_mm_set1_epi8(static_cast<char>((1 << bits) - 1))};
+  auto high{_mm_and_si128(_mm_srli_epi16(packed, bits), mask)};
+  auto low{_mm_and_si128(packed, mask)};
+  return _mm_unpacklo_epi8(high, low);
+}
+
+static __m128i unpack_group_simd(const std::byte *in, int code) {
+  switch (code) {
+  case 0:
+    return _mm_setzero_si128();
+  case 1: {
+    int32_t packed;
+    std::memcpy(&packed, in, sizeof(packed));
+    return split_fields(split_fields(_mm_cvtsi32_si128(packed), 4), 2);
+  }
+  case 2:
+    return split_fields(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in)),
+        4
+    );
+  default:
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+  }
+}
+
+// undoes the zigzag and the byte deltas, continuing from `previous`
+static __m128i integrate_group_simd(__m128i zigzagged, uint8_t previous) {
+  auto magnitude{
+      _mm_and_si128(_mm_srli_epi16(zigzagged, 1), _mm_set1_epi8(0x7f))
+  };
+  auto sign{_mm_sub_epi8(
+      _mm_setzero_si128(),
+      _mm_and_si128(zigzagged, _mm_set1_epi8(1))
+  )};
+  auto deltas{_mm_xor_si128(magnitude, sign)};
+
+  // inclusive prefix sum over the 16 bytes in four steps
+  deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 1));
+  deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 2));
+  deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 4));
+  deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 8));
+  return _mm_add_epi8(deltas, _mm_set1_epi8(static_cast<char>(previous)));
+}
+#else
+static uint8_t unzigzag8(uint8_t value) {
+  return static_cast<uint8_t>((value >> 1) ^ -(value & 1));
+}
+
+static void unpack_group(const std::byte *in, int code, Group &group) {
+  switch (code) {
+  case 0:
+    group.fill(0);
+    break;
+  case 1:
+    for (size_t byte{0}; byte < 4; ++byte) {
+      auto packed{static_cast<uint8_t>(in[byte])};
+      group[byte * 4] = packed >> 6;
+      group[byte * 4 + 1] = (packed >> 4) & 3;
+      group[byte * 4 + 2] = (packed >> 2) & 3;
+      group[byte * 4 + 3] = packed & 3;
+    }
+    break;
+  case 2:
+    for (size_t byte{0}; byte < 8; ++byte) {
+      auto packed{static_cast<uint8_t>(in[byte])};
+      group[byte * 2] = packed >> 4;
+      group[byte * 2 + 1] = packed & 15;
+    }
+    break;
+  default:
+    std::memcpy(group.data(), in, group.size());
+    break;
+  }
+}
+#endif
+
+// Decodes one lane of `count` vertex bytes and scatters it `stride` apart,
+// `previous` carries the last byte over to the next block
+static void decode_vertex_lane(
+    StreamReader &in,
+    size_t count,
+    std::byte *out,
+    size_t stride,
+    uint8_t &previous
+) {
+  auto group_count{(count + codec::group_size - 1) / codec::group_size};
+  for (size_t first_group{0}; first_group < group_count; first_group += 4) {
+    auto header{static_cast<uint8_t>(*in.take(1))};
+
+    for (size_t group_idx{first_group};
+         group_idx < std::min(group_count, first_group + 4);
+         ++group_idx) {
+      auto code{(header >> ((group_idx - first_group) * 2)) & 3};
+      auto packed{in.take(group_bytes[code])};
+
+      Group values;
+#if defined(__SSE2__)
+      auto decoded{
+          integrate_group_simd(unpack_group_simd(packed, code), previous)
+      };
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(values.data()), decoded);
+#else
+      unpack_group(packed, code, values);
+      auto running{previous};
+      for (auto &value : values) {
+        running = static_cast<uint8_t>(running + unzigzag8(value));
+        value = running;
+      }
+#endif
+      // padding deltas are zero, so the last value continues the lane
+      previous = values.back();
+
+      auto begin{group_idx * codec::group_size};
+      auto end{std::min(count, begin + codec::group_size)};
+      for (auto vertex{begin}; vertex < end; ++vertex)
+        out[vertex * stride] = static_cast<std::byte>(values[vertex - begin]);
+    }
+  }
+}
+
+// Decodes one lane of `count` raw bytes
+static void decode_lane(StreamReader &in, size_t count, uint8_t *out) {
+  auto group_count{(count + codec::group_size - 1) / codec::group_size};
+  for (size_t first_group{0}; first_group < group_count; first_group += 4) {
+    auto header{static_cast<uint8_t>(*in.take(1))};
+
+    for (size_t group_idx{first_group};
+         group_idx < std::min(group_count, first_group + 4);
+         ++group_idx) {
+      auto code{(header >> ((group_idx - first_group) * 2)) & 3};
+      auto packed{in.take(group_bytes[code])};
+
+      Group values;
+#if defined(__SSE2__)
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(values.data()),
+          unpack_group_simd(packed, code)
+      );
+#else
+      unpack_group(packed, code, values);
+#endif
+      auto begin{group_idx * codec::group_size};
+      auto end{std::min(count, begin + codec::group_size)};
+      std::copy(values.begin(), values.begin() + (end - begin), out + begin);
+    }
+  }
+}
+
+std::vector<std::byte> encode_vertex_stream(
+    std::span<const std::byte> vertices,
+    size_t count,
+    size_t stride
+) {
+  std::vector<std::byte> out{codec::vertex_tag};
+  auto byte_at = [&](size_t vertex, size_t lane) {
+    auto offset{vertex * stride + lane};
+    return offset < vertices.size() ? static_cast<uint8_t>(vertices[offset])
+                                    : uint8_t{0};
+  };
+
+  std::vector<uint8_t> lane_values;
+  for (size_t first{0}; first < count; first += codec::block_vertices) {
+    auto block_count{std::min(codec::block_vertices, count - first)};
+    for (size_t lane{0}; lane < stride; ++lane) {
+      lane_values.resize(block_count);
+      for (size_t vertex{0}; vertex < block_count; ++vertex) {
+        auto current{byte_at(first + vertex, lane)};
+        auto previous{
+            first + vertex > 0 ? byte_at(first + vertex - 1, lane) : uint8_t{0}
+        };
+        lane_values[vertex] = zigzag8(static_cast<uint8_t>(current - previous));
+      }
+      encode_lane(out, lane_values);
+    }
+  }
+  return out;
+}
+
+void decode_vertex_stream(
+    std::span<std::byte> out,
+    size_t count,
+    size_t stride,
+    std::span<const std::byte> encoded
+) {
+  if (out.size() < count * stride)
+    throw CodecError("output smaller than the stream");
+
+  StreamReader in{encoded};
+  if (*in.take(1) != codec::vertex_tag)
+    throw CodecError("not a vertex stream");
+
+  // last decoded byte of every lane, the baseline of the next block
+  std::vector<uint8_t> previous(stride, 0);
+  for (size_t first{0}; first < count; first += codec::block_vertices) {
+    auto block_count{std::min(codec::block_vertices, count - first)};
+    for (size_t lane{0}; lane < stride; ++lane) {
+      decode_vertex_lane(
+          in,
+          block_count,
+          out.data() + first * stride + lane,
+          stride,
+          previous[lane]
+      );
+    }
+  }
+
+  if (!in.finished())
+    throw CodecError("trailing data");
+}
+
+std::vector<std::byte> encode_index_stream(
+    std::span<const std::byte> indices,
+    size_t count,
+    IndexType type
+) {
+  auto size{index_size(type)};
+  auto bits{static_cast<unsigned>(size * 8)};
+  auto values{
+      decode_indices(IndexStreamData{.type = type, .bytes = indices}, count)
+  };
+
+  std::vector<std::byte> out{codec::index_tag};
+  std::vector<uint8_t> lane_values;
+  uint32_t previous{0};
+  for (size_t first{0}; first < count; first += codec::block_vertices) {
+    auto block_count{std::min(codec::block_vertices, count - first)};
+
+    std::vector<uint32_t> zigzagged(block_count);
+    for (size_t idx{0}; idx < block_count; ++idx) {
+      auto index{values[first + idx]};
+      zigzagged[idx] = zigzag(index - previous, bits);
+      previous = index;
+    }
+
+    for (size_t lane{0}; lane < size; ++lane) {
+      lane_values.resize(block_count);
+      for (size_t idx{0}; idx < block_count; ++idx)
+        lane_values[idx] = static_cast<uint8_t>(zigzagged[idx] >> (lane * 8));
+      encode_lane(out, lane_values);
+    }
+  }
+  return out;
+}
+
+void decode_index_stream(
+    std::span<std::byte> out,
+    size_t count,
+    IndexType type,
+    std::span<const std::byte> encoded
+) {
+  auto size{index_size(type)};
+  if (out.size() < count * size)
+    throw CodecError("output smaller than the stream");
+
+  StreamReader in{encoded};
+  if (*in.take(1) != codec::index_tag)
+    throw CodecError("not an index stream");
+
+  auto mask{size == 4 ? 0xffffffffu : (1u << (size * 8)) - 1};
+  std::array<std::array<uint8_t, codec::block_vertices>, 4> lanes;
+  uint32_t previous{0};
+  for (size_t first{0}; first < count; first += codec::block_vertices) {
+    auto block_count{std::min(codec::block_vertices, count - first)};
+    for (size_t lane{0}; lane < size; ++lane)
+      decode_lane(in, block_count, lanes[lane].data());
+
+    for (size_t idx{0}; idx < block_count; ++idx) {
+      uint32_t zigzagged{0};
+      for (size_t lane{0}; lane < size; ++lane)
+        zigzagged |= uint32_t{lanes[lane][idx]} << (lane * 8);
+
+      // sign extend the difference to the width of the index type
+      auto delta{unzigzag(zigzagged)};
+      previous = (previous + delta) & mask;
+      std::memcpy(out.data() + (first + idx) * size, &previous, size);
+    }
+  }
+
+  if (!in.finished())
+    throw CodecError("trailing data");
+}
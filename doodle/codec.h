@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vertex.h"
+
+// Lossless geometry codec for vertex and index streams
+//
+// Streams are split into blocks of codec::block_vertices elements. Within a
+// block every byte position of the element is stored as its own lane, so
+// the slowly changing high bytes of neighbouring values end up next to each
+// other. Lanes are coded in groups of 16 bytes, each packed into 0, 2, 4 or
+// 8 bits per byte as selected by a 2-bit header. Vertex lanes hold the
+// zigzagged difference to the same byte of the previous vertex, index lanes
+// the bytes of the zigzagged difference to the previous index.
+namespace codec {
+constexpr size_t block_vertices{256};
+constexpr size_t group_size{16};
+constexpr std::byte vertex_tag{0xa1};
+constexpr std::byte index_tag{0xb1};
+// decoded bytes per encoded byte at most, a header byte covers four groups
+constexpr size_t max_expansion{4 * group_size};
+} // namespace codec
+
+class CodecError : public std::runtime_error {
+public:
+  explicit CodecError(const std::string &reason)
+      : std::runtime_error(
+            std::format("Corrupt geometry stream: {}", reason)
+        ) {}
+};
+
+// Encodes `count` vertices of `stride` bytes, bytes past the end of
+// `vertices` read as zero
+std::vector<std::byte> encode_vertex_stream(
+    std::span<const std::byte> vertices,
+    size_t count,
+    size_t stride
+);
+
+// Decodes into `out`, which must hold count * stride bytes
+void decode_vertex_stream(
+    std::span<std::byte> out,
+    size_t count,
+    size_t stride,
+    std::span<const std::byte> encoded
+);
+
+std::vector<std::byte> encode_index_stream(
+    std::span<const std::byte> indices,
+    size_t count,
+    IndexType type
+);
+
+// Decodes into `out`, which must hold count indices of `type`
+void decode_index_stream(
+    std::span<std::byte> out,
+    size_t count,
+    IndexType type,
+    std::span<const std::byte> encoded
+);
@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "cook_cache.h"
+#include "dmesh.h"
+#include "file.h"
+#include "gltf.h"
+#include "loader.h"
+#include "lod.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "obj.h"
+#include "optimize.h"
+#include "pack.h"
+#include "quantize.h"
+
+namespace fs = std::filesystem;
+using std::string_view;
+
+// Offline asset cooker
+// Converts source assets into the formats the runtime maps and uploads
+// without further processing:
+//   .obj, .gltf, .glb          -> .dmesh per primitive, reordered for
+//                                 vertex cache, overdraw and fetch locality
+//                                 quantized within the error bounds, with
+//                                 coarser levels of detail as vertex
+//                                 prefixes and split into meshlets,
+//                                 optionally as triangle strips when those
+//                                 are smaller, with vertex and index streams
+//                                 compressed
+//   .vert, .frag, .glsl, ...   -> validated shader source, .glsl being
+//                                 headers for #include
+//   .toml                      -> scene manifest, copied as is
+// With --pack every output is also stored in a single asset pack, named by
+// its file name. Cooked meshes are kept in a content-addressed cache, so
+// inputs are only processed again when they or the options changed.
+
+struct CookOptions {
+  fs::path output_dir{"."};
+  bool optimize{true};
+  bool quantize{true};
+  bool meshlets{true};
+  // coarser levels of detail generated below each mesh
+  size_t lods{3};
+  bool strips{false};
+  bool compress{true};
+  std::optional<fs::path> pack;
+  std::optional<fs::path> cache{cook_cache::default_directory};
+  QuantizeSettings quantize_settings;
+  size_t thread_count{std::max(1u, std::thread::hardware_concurrency())};
+  std::vector<fs::path> inputs;
+};
+
+static void print_usage() {
+  std::println(
+      stderr,
+      "usage: doodle-cook [-o <output dir>] [-j <threads>] [--pack <file>] "
+      "[--cache <dir>] [--no-cache] [--no-optimize] "
+      "[--no-quantize] [--lods <count>] [--no-meshlets] [--strips] "
+      "[--no-compress] [--position-error <relative>] [--normal-error <abs>] "
+      "[--texcoord-error <abs>] <inputs...>"
+  );
+}
+
+static CookOptions parse_options(int argc, char **argv) {
+  CookOptions options;
+  for (int arg_idx{1}; arg_idx < argc; ++arg_idx) {
+    string_view arg{argv[arg_idx]};
+
+    auto value = [&]() -> string_view {
+      if (arg_idx + 1 >= argc)
+        throw std::runtime_error(std::format("Missing value for {}", arg));
+      return argv[++arg_idx];
+    };
+
+    auto error_value = [&]() {
+      auto text{value()};
+      float error;
+      auto [end, result]{
+          std::from_chars(text.data(), text.data() + text.size(), error)
+      };
+      if (result != std::errc{} || !(error >= 0.0f))
+        throw std::runtime_error(std::format("Invalid error bound {}", text));
+      return error;
+    };
+
+    if (arg == "-o") {
+      options.output_dir = value();
+    } else if (arg == "-j") {
+      auto count{value()};
+      auto [end, error]{std::from_chars(
+          count.data(),
+          count.data() + count.size(),
+          options.thread_count
+      )};
+      if (error != std::errc{} || options.thread_count == 0)
+        throw std::runtime_error(std::format("Invalid thread count {}", count));
+    } else if (arg == "--pack") {
+      options.pack = value();
+    } else if (arg == "--cache") {
+      options.cache = value();
+    } else if (arg == "--no-cache") {
+      options.cache.reset();
+    } else if (arg == "--no-optimize") {
+      options.optimize = false;
+    } else if (arg == "--no-quantize") {
+      options.quantize = false;
+    } else if (arg == "--lods") {
+      auto count{value()};
+      auto [end, error]{std::from_chars(
+          count.data(),
+          count.data() + count.size(),
+          options.lods
+      )};
+      if (error != std::errc{})
+        throw std::runtime_error(std::format("Invalid level count {}", count));
+    } else if (arg == "--no-meshlets") {
+      options.meshlets = false;
+    } else if (arg == "--strips") {
+      options.strips = true;
+    } else if (arg == "--no-compress") {
+      options.compress = false;
+    } else if (arg == "--position-error") {
+      options.quantize_settings.position_error = error_value();
+    } else if (arg == "--normal-error") {
+      options.quantize_settings.normal_error = error_value();
+    } else if (arg == "--texcoord-error") {
+      options.quantize_settings.texcoord_error = error_value();
+    } else if (arg.starts_with('-')) {
+      throw std::runtime_error(std::format("Unknown option {}", arg));
+    } else {
+      options.inputs.emplace_back(arg);
+    }
+  }
+  return options;
+}
+
+// writes to a temporary sibling first, so the runtime never maps a
+// partially written file
+template <typename Write>
+static void write_atomically(const fs::path &path, Write &&write) {
+  // unique per thread, two inputs may cook to the same output name
+  auto temporary{path};
+  temporary += std::format(
+      ".{}.tmp",
+      std::hash<std::thread::id>{}(std::this_thread::get_id())
+  );
+  try {
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    if (!out) {
+      throw std::runtime_error(
+          std::format("Failed to open {} for writing", temporary.string())
+      );
+    }
+    write(out);
+    out.close();
+    if (!out) {
+      throw std::runtime_error(
+          std::format("Failed to write {}", temporary.string())
+      );
+    }
+    fs::rename(temporary, path);
+  } catch (...) {
+    std::error_code error;
+    fs::remove(temporary, error);
+    throw;
+  }
+}
+
+// whether the first directive of `text`, after whitespace and comments, is
+// #version
+static bool starts_with_version(string_view text) {
+  while (!text.empty()) {
+    if (std::isspace(static_cast<unsigned char>(text.front()))) {
+      text.remove_prefix(1);
+    } else if (text.starts_with("//")) {
+      auto end{text.find('\n')};
+      text = end == string_view::npos ? string_view{} : text.substr(end);
+    } else if (text.starts_with("/*")) {
+      auto end{text.find("*/", 2)};
+      if (end == string_view::npos)
+        return false;
+      text.remove_prefix(end + 2);
+    } else {
+      break;
+    }
+  }
+  return text.starts_with("#version");
+}
+
+static std::vector<MeshData>
+import_meshes(const fs::path &input, ThreadPool &pool) {
+  auto extension{input.extension()};
+  if (extension == ".obj") {
+    std::vector<MeshData> meshes;
+    meshes.push_back(import_obj(input, pool));
+    return meshes;
+  }
+  return import_gltf(input, pool);
+}
+
+struct CookOutput {
+  fs::path path;
+  // extra per-output statistics for the log
+  std::string details;
+};
+
+// every option that changes cooked meshes, and the format they are written in
+static std::string mesh_settings(const CookOptions &options) {
+  const auto &quantize{options.quantize_settings};
+  return std::format(
+      "dmesh {} optimize {} quantize {} {} {} {} lods {} meshlets {} "
+      "strips {} compress {}",
+      dmesh::version,
+      options.optimize,
+      options.quantize,
+      quantize.position_error,
+      quantize.normal_error,
+      quantize.texcoord_error,
+      options.lods,
+      options.meshlets,
+      options.strips,
+      options.compress
+  );
+}
+
+// multi-primitive sources get one file per primitive
+static fs::path mesh_output(
+    const fs::path &input,
+    const CookOptions &options,
+    size_t mesh_idx,
+    size_t mesh_count
+) {
+  auto stem{input.stem().string()};
+  auto name{
+      mesh_count == 1 ? std::format("{}.dmesh", stem)
+                      : std::format("{}_{}.dmesh", stem, mesh_idx)
+  };
+  return options.output_dir / name;
+}
+
+static std::vector<CookOutput> write_cached_meshes(
+    const fs::path &input,
+    const CookOptions &options,
+    const Pack &entry
+) {
+  std::vector<CookOutput> outputs;
+  for (size_t mesh_idx{0}; mesh_idx < entry.size(); ++mesh_idx) {
+    auto blob{entry.find(std::format("{}", mesh_idx))};
+    if (!blob)
+      throw std::runtime_error("Cache entry lacks an output");
+
+    auto output{mesh_output(input, options, mesh_idx, entry.size())};
+    write_atomically(output, [&](std::ostream &out) {
+      auto bytes{blob->bytes()};
+      out.write(
+          reinterpret_cast<const char *>(bytes.data()),
+          static_cast<std::streamsize>(bytes.size())
+      );
+    });
+    outputs.push_back({std::move(output), ", cached"});
+  }
+  return outputs;
+}
+
+static void store_cached_meshes(
+    const CookCache &cache,
+    uint64_t key,
+    std::span<const CookOutput> outputs
+) {
+  // maps stay open until the entry is written
+  std::vector<MappedFile> mapped;
+  std::vector<PackInput> inputs;
+  mapped.reserve(outputs.size());
+  for (size_t output_idx{0}; output_idx < outputs.size(); ++output_idx) {
+    const auto &contents{mapped.emplace_back(outputs[output_idx].path)};
+    inputs.push_back({std::format("{}", output_idx), contents.bytes()});
+  }
+  cache.store(key, inputs);
+}
+
+static std::vector<CookOutput> cook_meshes(
+    const fs::path &input,
+    const CookOptions &options,
+    ThreadPool &pool,
+    const CookCache *cache
+) {
+  // keyed by everything the import reads, an unchanged input is copied from
+  // its entry instead of being processed
+  std::optional<uint64_t> key;
+  if (cache) {
+    std::vector<fs::path> sources{input};
+    if (input.extension() != ".obj") {
+      auto buffers{gltf_buffer_files(input)};
+      sources.insert(sources.end(), buffers.begin(), buffers.end());
+    }
+    key = cache->key(sources, mesh_settings(options));
+    if (auto entry{cache->load(*key)}; entry && entry->size() > 0)
+      return write_cached_meshes(input, options, *entry);
+  }
+
+  auto meshes{import_meshes(input, pool)};
+
+  // meshes are independent, run the per-mesh passes across the pool
+  std::vector<std::string> details(meshes.size());
+  parallel_for(pool, meshes.size(), [&](size_t mesh_idx) {
+    auto &mesh{meshes[mesh_idx]};
+    validate_mesh(mesh);
+    fit_index_type(mesh);
+
+    if (options.optimize && mesh.indices) {
+      auto report{optimize_mesh(mesh)};
+      details[mesh_idx] += std::format(
+          ", ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+          report.before.acmr,
+          report.after.acmr,
+          report.before.atvr,
+          report.after.atvr
+      );
+    }
+
+    // after the fetch pass, which drops unreferenced vertices
+    if (options.quantize) {
+      auto report{quantize_mesh(mesh, options.quantize_settings)};
+      details[mesh_idx] += std::format(
+          ", vertex {} -> {} bytes",
+          report.vertex_size_before,
+          report.vertex_size_after
+      );
+    }
+
+    // reorders vertices again, from the coarsest level's to the mesh's own
+    if (options.lods > 0 && mesh.indices &&
+        mesh.primitive == Primitive::triangles) {
+      auto report{build_lods(mesh, LodSettings{.max_levels = options.lods})};
+      if (report.triangle_counts.size() > 1) {
+        details[mesh_idx] += ", lods";
+        for (size_t level{0}; level < report.triangle_counts.size(); ++level) {
+          details[mesh_idx] += std::format(
+              "{}{}",
+              level == 0 ? " " : " -> ",
+              report.triangle_counts[level]
+          );
+        }
+        details[mesh_idx] += " triangles";
+      }
+    }
+
+    // last, bounds are computed from the final positions
+    if (options.meshlets && mesh.indices) {
+      auto start{std::chrono::steady_clock::now()};
+      build_meshlets(mesh, pool);
+      std::chrono::duration<double, std::milli> elapsed{
+          std::chrono::steady_clock::now() - start
+      };
+      details[mesh_idx] += std::format(
+          ", {} meshlets in {:.1f} ms",
+          mesh.meshlets->count,
+          elapsed.count()
+      );
+    }
+
+    // meshlets keep their own triangle lists, strips only replace the
+    // index buffer
+    if (options.strips && mesh.indices &&
+        mesh.primitive == Primitive::triangles) {
+      auto list_count{mesh.index_count};
+      if (stripify_mesh(mesh)) {
+        details[mesh_idx] += std::format(
+            ", strips {} -> {} indices",
+            list_count,
+            mesh.index_count
+        );
+      }
+    }
+  });
+
+  std::vector<CookOutput> outputs;
+  for (size_t mesh_idx{0}; mesh_idx < meshes.size(); ++mesh_idx) {
+    const auto &mesh{meshes[mesh_idx]};
+    auto output{mesh_output(input, options, mesh_idx, meshes.size())};
+
+    GeometrySize geometry;
+    write_atomically(output, [&](std::ostream &out) {
+      geometry = write_dmesh(out, mesh, options.compress);
+    });
+    if (options.compress) {
+      details[mesh_idx] += std::format(
+          ", geometry {} -> {} bytes",
+          geometry.raw,
+          geometry.stored
+      );
+    }
+    outputs.push_back({std::move(output), std::move(details[mesh_idx])});
+  }
+
+  if (key)
+    store_cached_meshes(*cache, *key, outputs);
+  return outputs;
+}
+
+static std::vector<CookOutput>
+cook_shader(const fs::path &input, const CookOptions &options) {
+  MappedFile source{input};
+  auto text{source.text()};
+
+  // GLSL can only be compiled with a context, check what can be checked here;
+  // .glsl files are #include targets, which have no #version of their own
+  if (input.extension() != ".glsl" && !starts_with_version(text))
+    throw std::runtime_error("Shader does not start with a #version directive");
+
+  auto output{options.output_dir / input.filename()};
+  write_atomically(output, [&](std::ostream &out) {
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  });
+  return {{output, {}}};
+}
+
+static std::vector<CookOutput>
+cook_manifest(const fs::path &input, const CookOptions &options) {
+  // parsed by the runtime, which links the TOML parser
+  MappedFile source{input};
+  auto text{source.text()};
+
+  auto output{options.output_dir / input.filename()};
+  write_atomically(output, [&](std::ostream &out) {
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  });
+  return {{output, {}}};
+}
+
+static void
+write_pack_file(const fs::path &path, std::span<const fs::path> files) {
+  // maps stay open until the pack is written
+  std::vector<MappedFile> mapped;
+  std::vector<PackInput> inputs;
+  mapped.reserve(files.size());
+  inputs.reserve(files.size());
+  for (const auto &file : files) {
+    const auto &contents{mapped.emplace_back(file)};
+    inputs.push_back({file.filename().string(), contents.bytes()});
+  }
+
+  write_atomically(path, [&](std::ostream &out) { write_pack(out, inputs); });
+}
+
+static bool is_mesh_source(const fs::path &path) {
+  auto extension{path.extension()};
+  return extension == ".obj" || extension == ".gltf" || extension == ".glb";
+}
+
+static bool is_shader_source(const fs::path &path) {
+  auto extension{path.extension()};
+  return extension == ".vert" || extension == ".frag" ||
+         extension == ".geom" || extension == ".comp" ||
+         extension == ".tesc" || extension == ".tese" ||
+         extension == ".glsl";
+}
+
+static bool is_manifest(const fs::path &path) {
+  return path.extension() == ".toml";
+}
+
+int main(int argc, char **argv) {
+  CookOptions options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (const std::exception &error) {
+    std::println(stderr, "{}", error.what());
+    print_usage();
+    return 2;
+  }
+  if (options.inputs.empty()) {
+    print_usage();
+    return 2;
+  }
+
+  fs::create_directories(options.output_dir);
+
+  // the calling thread takes part in parallel_for, so one fewer worker
+  ThreadPool pool{options.thread_count - 1};
+  std::optional<CookCache> cache;
+  if (options.cache)
+    cache.emplace(*options.cache);
+  std::mutex output_mutex;
+  std::atomic<size_t> failures{0};
+  std::vector<fs::path> cooked;
+
+  // inputs are cooked concurrently, and importers spread each input over
+  // the same pool
+  parallel_for(pool, options.inputs.size(), [&](size_t input_idx) {
+    const auto &input{options.inputs[input_idx]};
+    auto start{std::chrono::steady_clock::now()};
+
+    try {
+      std::vector<CookOutput> outputs;
+      if (is_mesh_source(input))
+        outputs = cook_meshes(input, options, pool, cache ? &*cache : nullptr);
+      else if (is_shader_source(input))
+        outputs = cook_shader(input, options);
+      else if (is_manifest(input))
+        outputs = cook_manifest(input, options);
+      else
+        throw std::runtime_error("Unrecognized asset type");
+
+      std::chrono::duration<double, std::milli> elapsed{
+          std::chrono::steady_clock::now() - start
+      };
+      std::lock_guard lock{output_mutex};
+      for (const auto &output : outputs) {
+        cooked.push_back(output.path);
+        std::println(
+            "{} -> {} ({:.1f} ms{})",
+            input.string(),
+            output.path.string(),
+            elapsed.count(),
+            output.details
+        );
+      }
+    } catch (const std::exception &error) {
+      ++failures;
+      std::lock_guard lock{output_mutex};
+      std::println(stderr, "{}: {}", input.string(), error.what());
+    }
+  });
+
+  // a pack missing assets would fail at runtime instead, skip it
+  if (options.pack && failures == 0) {
+    try {
+      write_pack_file(*options.pack, cooked);
+      std::println("{} assets -> {}", cooked.size(), options.pack->string());
+    } catch (const std::exception &error) {
+      ++failures;
+      std::println(stderr, "{}: {}", options.pack->string(), error.what());
+    }
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#include "cook_cache.h"
+
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "file.h"
+#include "hash.h"
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+CookCache::CookCache(fs::path directory) : directory(std::move(directory)) {}
+
+fs::path CookCache::entry_path(uint64_t key) const {
+  return directory / std::format("{:016x}.dpak", key);
+}
+
+std::optional<Pack> CookCache::load(uint64_t key) const {
+  auto path{entry_path(key)};
+  std::error_code error;
+  if (!fs::is_regular_file(path, error))
+    return std::nullopt;
+
+  // an unreadable or damaged entry is a miss, the asset gets cooked again
+  try {
+    return Pack{path};
+  } catch (const std::runtime_error &) {
+    return std::nullopt;
+  }
+}
+
+void CookCache::store(uint64_t key, std::span<const PackInput> outputs) const {
+  std::error_code error;
+  fs::create_directories(directory, error);
+  if (error)
+    return;
+
+  // written to a temporary sibling first, so no process maps a partial
+  // entry; unique per process and thread, as both cook concurrently
+  auto path{entry_path(key)};
+  auto temporary{path};
+  temporary += std::format(
+      ".{}.{}.tmp",
+      getpid(),
+      std::hash<std::thread::id>{}(std::this_thread::get_id())
+  );
+  try {
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    write_pack(out, outputs);
+    if (!out)
+      throw std::runtime_error("write failed");
+  } catch (const std::exception &) {
+    fs::remove(temporary, error);
+    return;
+  }
+  fs::rename(temporary, path, error);
+}
+
+fs::path CookCache::index_path() const { return directory / "stamps"; }
+
+// Lines of "hash size modified path", appended as sources are hashed, where
+// later lines for a path replace earlier ones. Unparsable lines are skipped,
+// costing only a rehash.
+std::unordered_map<std::string, CookCache::Stamp> &
+CookCache::load_stamps() const {
+  if (stamps)
+    return *stamps;
+
+  auto &index{stamps.emplace()};
+  size_t line_count{0};
+  std::ifstream in{index_path()};
+  std::string line;
+  while (std::getline(in, line)) {
+    ++line_count;
+    Stamp stamp;
+    const auto *begin{line.data()};
+    const auto *end{line.data() + line.size()};
+    auto [hash_end, hash_error]{std::from_chars(begin, end, stamp.hash, 16)};
+    if (hash_error != std::errc{} || hash_end == end || *hash_end != ' ')
+      continue;
+    auto [size_end, size_error]{
+        std::from_chars(hash_end + 1, end, stamp.size)
+    };
+    if (size_error != std::errc{} || size_end == end || *size_end != ' ')
+      continue;
+    auto [time_end, time_error]{
+        std::from_chars(size_end + 1, end, stamp.modified)
+    };
+    if (time_error != std::errc{} || time_end == end || *time_end != ' ')
+      continue;
+    index.insert_or_assign(std::string{time_end + 1, end}, stamp);
+  }
+
+  // rewrite an index mostly made of replaced lines, racing appends from other
+  // processes only lose stamps
+  if (line_count > 2 * index.size() + 64) {
+    auto temporary{index_path()};
+    temporary += std::format(".{}.tmp", getpid());
+    std::error_code error;
+    {
+      std::ofstream out{temporary, std::ios::trunc};
+      for (const auto &[source, stamp] : index) {
+        out << std::format(
+            "{:016x} {} {} {}\n",
+            stamp.hash,
+            stamp.size,
+            stamp.modified,
+            source
+        );
+      }
+      out.close();
+      if (!out) {
+        fs::remove(temporary, error);
+        return index;
+      }
+    }
+    fs::rename(temporary, index_path(), error);
+  }
+  return index;
+}
+
+void CookCache::append_stamp(
+    const std::string &source,
+    const Stamp &stamp
+) const {
+  std::error_code error;
+  fs::create_directories(directory, error);
+  if (error)
+    return;
+
+  // one write per line, so appends from concurrent processes stay whole
+  auto line{std::format(
+      "{:016x} {} {} {}\n",
+      stamp.hash,
+      stamp.size,
+      stamp.modified,
+      source
+  )};
+  std::ofstream out{index_path(), std::ios::app};
+  out.write(line.data(), static_cast<std::streamsize>(line.size()));
+}
+
+uint64_t CookCache::content_hash(const fs::path &source) const {
+  // stamped before reading, so a write during the hash leaves a stamp that
+  // no longer matches on the next run
+  auto name{fs::absolute(source).lexically_normal().string()};
+  auto size{static_cast<uint64_t>(fs::file_size(source))};
+  auto modified{static_cast<int64_t>(
+      fs::last_write_time(source).time_since_epoch().count()
+  )};
+  {
+    std::lock_guard lock{mutex};
+    auto &index{load_stamps()};
+    auto it{index.find(name)};
+    if (it != index.end() && it->second.size == size &&
+        it->second.modified == modified)
+      return it->second.hash;
+  }
+
+  MappedFile file{source};
+  Stamp stamp{.size = size, .modified = modified, .hash = fnv1a(file.bytes())};
+
+  std::lock_guard lock{mutex};
+  load_stamps().insert_or_assign(name, stamp);
+  append_stamp(name, stamp);
+  return stamp.hash;
+}
+
+uint64_t CookCache::key(
+    std::span<const fs::path> sources,
+    std::string_view settings
+) const {
+  auto key{fnv1a(std::format("cook {}\n{}\n", cook_cache::version, settings))};
+  for (const auto &source : sources) {
+    auto hash{content_hash(source)};
+    key = fnv1a(std::as_bytes(std::span{&hash, 1}), key);
+  }
+  return key;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "pack.h"
+
+// Content-addressed on-disk cache of cooked assets
+//
+// An entry is keyed by the contents of every file a cook read together with
+// the settings it ran with, and holds its outputs as an asset pack named
+// "0", "1", ... in output order. Changed sources or settings simply miss,
+// while hits are mapped and served from the entry without copying. doodle-cook
+// and the runtime importer share entries through the same directory.
+//
+// Content hashes are remembered in a stamp index next to the entries, by path,
+// size and modification time, so a source is only read again once it changed.
+namespace cook_cache {
+constexpr uint32_t version{2};
+constexpr std::string_view default_directory{"cache/cooked"};
+} // namespace cook_cache
+
+// Safe to use from any thread
+class CookCache {
+  // content hash of a source as of its size and modification time
+  struct Stamp {
+    uint64_t size;
+    int64_t modified;
+    uint64_t hash;
+  };
+
+  std::filesystem::path directory;
+  mutable std::mutex mutex;
+  // read from the index on first use, by absolute source path
+  mutable std::optional<std::unordered_map<std::string, Stamp>> stamps;
+
+  std::filesystem::path entry_path(uint64_t key) const;
+  std::filesystem::path index_path() const;
+  std::unordered_map<std::string, Stamp> &load_stamps() const;
+  void append_stamp(const std::string &source, const Stamp &stamp) const;
+  uint64_t content_hash(const std::filesystem::path &source) const;
+
+public:
+  explicit CookCache(std::filesystem::path directory);
+
+  // returns the mapped outputs, or nothing when there is no readable entry
+  std::optional<Pack> load(uint64_t key) const;
+
+  // stores the outputs of a cook, failures to write only cost a cook on the
+  // next run
+  void store(uint64_t key, std::span<const PackInput> outputs) const;
+
+  // Key of a cook reading `sources` with `settings`, which has to spell out
+  // every option and output format version the result depends on
+  // Throws std::runtime_error when a source cannot be read.
+  uint64_t key(
+      std::span<const std::filesystem::path> sources,
+      std::string_view settings
+  ) const;
+};
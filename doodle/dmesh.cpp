@@ -0,0 +1,683 @@
+#include "dmesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "codec.h"
+
+static size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// copies a trivially copyable record out of the file, the mapping is page
+// aligned but records further in are not guaranteed to be
+template <typename T>
+static T read_record(std::span<const std::byte> bytes, size_t offset) {
+  if (offset + sizeof(T) > bytes.size())
+    throw MeshFormatError("truncated header");
+
+  T record;
+  std::memcpy(&record, bytes.data() + offset, sizeof(T));
+  return record;
+}
+
+static std::span<const std::byte>
+payload(std::span<const std::byte> bytes, const dmesh::Range &range) {
+  if (range.offset > bytes.size() || range.size > bytes.size() - range.offset)
+    throw MeshFormatError("payload range out of bounds");
+
+  return bytes.subspan(range.offset, range.size);
+}
+
+// Enum fields are checked before they are cast, unknown values would reach
+// GL as invalid enums
+static Primitive read_primitive(uint32_t value) {
+  switch (static_cast<Primitive>(value)) {
+  case Primitive::triangles:
+  case Primitive::triangle_strip:
+    return static_cast<Primitive>(value);
+  }
+  throw MeshFormatError(std::format("unknown primitive {:#x}", value));
+}
+
+static IndexType read_index_type(uint32_t value) {
+  switch (static_cast<IndexType>(value)) {
+  case IndexType::u8:
+  case IndexType::u16:
+  case IndexType::u32:
+    return static_cast<IndexType>(value);
+  }
+  throw MeshFormatError(std::format("unknown index type {:#x}", value));
+}
+
+static AttribType read_attrib_type(uint32_t value) {
+  switch (static_cast<AttribType>(value)) {
+  case AttribType::f16:
+  case AttribType::f32:
+  case AttribType::f64:
+  case AttribType::i8:
+  case AttribType::u8:
+  case AttribType::i16:
+  case AttribType::u16:
+  case AttribType::i10_10_10_2:
+  case AttribType::u10_10_10_2:
+    return static_cast<AttribType>(value);
+  }
+  throw MeshFormatError(std::format("unknown attribute type {:#x}", value));
+}
+
+static AttribLocation read_attrib_location(uint32_t value) {
+  switch (static_cast<AttribLocation>(value)) {
+  case AttribLocation::position:
+  case AttribLocation::normal:
+  case AttribLocation::texcoord:
+    return static_cast<AttribLocation>(value);
+  }
+  throw MeshFormatError(std::format("unknown attribute location {}", value));
+}
+
+// whether `count` elements of `element_size` bytes can come from `data`,
+// checked before multiplying so crafted counts cannot wrap the size
+static bool fits(
+    uint64_t count,
+    size_t element_size,
+    std::span<const std::byte> data,
+    bool compressed
+) {
+  if (element_size == 0)
+    return true;
+  auto limit{compressed ? data.size() * codec::max_expansion : data.size()};
+  return count <= limit / element_size;
+}
+
+// decoding of a vertex segment or an index blob
+struct VertexSegment {
+  std::span<const std::byte> encoded;
+  std::span<std::byte> out;
+  size_t count;
+  size_t stride;
+};
+
+struct IndexSegment {
+  std::span<const std::byte> encoded;
+  std::span<std::byte> out;
+  size_t count;
+  IndexType type;
+};
+
+// what makes one level readable, raw blobs only have to be faulted in
+struct LevelPlan {
+  std::vector<VertexSegment> vertices;
+  std::vector<IndexSegment> indices;
+  std::vector<dmesh::Range> populate;
+};
+
+// buffer for a decoded blob, left uninitialized as decoding writes every byte
+static std::span<std::byte> decode_buffer(size_t size, MeshData &mesh) {
+  auto buffer{std::make_shared_for_overwrite<std::byte[]>(size)};
+  std::span<std::byte> bytes{buffer.get(), size};
+  mesh.storage.push_back(std::move(buffer));
+  return bytes;
+}
+
+// plans reading an index blob of `count` indices as part of `plan`
+static IndexStreamData read_index_blob(
+    const Asset &asset,
+    const dmesh::Range &range,
+    size_t count,
+    IndexType type,
+    bool compressed,
+    MeshData &mesh,
+    LevelPlan &plan
+) {
+  auto data{payload(asset.bytes(), range)};
+  if (!fits(count, index_size(type), data, compressed))
+    throw MeshFormatError("index stream smaller than index count");
+
+  if (compressed) {
+    auto decoded_size{count * index_size(type)};
+    auto decoded{decode_buffer(decoded_size, mesh)};
+    plan.indices.push_back({data, decoded, count, type});
+    return IndexStreamData{.type = type, .bytes = decoded};
+  }
+
+  plan.populate.push_back(range);
+  return IndexStreamData{.type = type, .bytes = data};
+}
+
+MeshLevelReader read_dmesh_levels(const Asset &asset) {
+  auto bytes{asset.bytes()};
+
+  auto header{read_record<dmesh::Header>(bytes, 0)};
+  if (header.magic != dmesh::magic)
+    throw MeshFormatError("bad magic");
+  if (header.version != dmesh::version) {
+    throw MeshFormatError(std::format(
+        "unsupported version {}, expected {}",
+        header.version,
+        dmesh::version
+    ));
+  }
+
+  auto compressed{(header.flags & dmesh::compressed_geometry) != 0};
+  MeshData mesh{
+      .primitive = read_primitive(header.primitive),
+      .vertex_count = header.vertex_count,
+      .index_count = header.index_count,
+  };
+
+  if (header.stream_count > bytes.size() / sizeof(dmesh::Stream))
+    throw MeshFormatError("truncated header");
+
+  // level tables follow the stream and meshlet records
+  auto lod_offset{
+      sizeof(dmesh::Header) + header.stream_count * sizeof(dmesh::Stream) +
+      ((header.flags & dmesh::has_meshlets) ? sizeof(dmesh::Meshlets) : 0)
+  };
+  auto segment_offset{lod_offset + header.lod_count * sizeof(dmesh::Lod)};
+  if (header.lod_count > bytes.size() / sizeof(dmesh::Lod))
+    throw MeshFormatError("truncated header");
+
+  std::vector<dmesh::Lod> lods;
+  lods.reserve(header.lod_count);
+  for (uint32_t lod_idx{0}; lod_idx < header.lod_count; ++lod_idx) {
+    auto lod{read_record<dmesh::Lod>(
+        bytes,
+        lod_offset + lod_idx * sizeof(dmesh::Lod)
+    )};
+    auto previous{lods.empty() ? 0 : lods.back().vertex_count};
+    if (lod.vertex_count < previous || lod.vertex_count > header.vertex_count)
+      throw MeshFormatError("level of detail vertex counts out of order");
+    if (lod.index_type == 0 || lod.index_count % 3 != 0)
+      throw MeshFormatError("level of detail is not an indexed triangle list");
+    read_index_type(lod.index_type);
+    lods.push_back(lod);
+  }
+
+  // vertices [level_begin(level), level_end(level)) belong to a level
+  auto level_end = [&](size_t level) {
+    return level < lods.size() ? lods[level].vertex_count : header.vertex_count;
+  };
+  auto level_begin = [&](size_t level) {
+    return level == 0 ? 0 : level_end(level - 1);
+  };
+  std::vector<LevelPlan> plans(lods.size() + 1);
+  auto &finest{plans.back()};
+
+  mesh.streams.reserve(header.stream_count);
+  for (uint32_t stream_idx{0}; stream_idx < header.stream_count; ++stream_idx) {
+    auto stream{read_record<dmesh::Stream>(
+        bytes,
+        sizeof(dmesh::Header) + stream_idx * sizeof(dmesh::Stream)
+    )};
+
+    if (stream.attrib_count > dmesh::max_attribs)
+      throw MeshFormatError("too many vertex attributes");
+    if (stream.stride == 0)
+      throw MeshFormatError("vertex stream has a stride of 0");
+
+    VertexFormat format{.stride = stream.stride};
+    for (uint32_t attrib_idx{0}; attrib_idx < stream.attrib_count;
+         ++attrib_idx) {
+      const auto &attrib{stream.attribs[attrib_idx]};
+      format.attribs.push_back(VertexAttrib{
+          .props =
+              VertexAttribProps{
+                  .location = read_attrib_location(attrib.location),
+                  .type = read_attrib_type(attrib.type),
+                  .size = attrib.size,
+              },
+          .offset = attrib.offset,
+          .normalized = attrib.normalized != 0,
+      });
+
+      // attributes are read within each vertex
+      const auto &props{format.attribs.back().props};
+      if (props.size < 1 || props.size > 4) {
+        throw MeshFormatError(
+            std::format("attribute size {} out of range", props.size)
+        );
+      }
+      if (attrib.offset > stream.stride ||
+          attrib_size(props) > stream.stride - attrib.offset) {
+        throw MeshFormatError(std::format(
+            "attribute at location {} extends past the stride of {}",
+            attrib.location,
+            stream.stride
+        ));
+      }
+    }
+
+    auto data{payload(bytes, stream.data)};
+    auto stride{format.stride};
+    // level vertex counts are at most the vertex count, so this bounds
+    // every offset into the stream as well
+    if (!fits(header.vertex_count, stride, data, compressed))
+      throw MeshFormatError("vertex stream smaller than vertex count");
+
+    if (compressed) {
+      auto decoded_size{header.vertex_count * stride};
+
+      // every level's segment decodes on its own into its part of the stream
+      auto decoded{decode_buffer(decoded_size, mesh)};
+      uint64_t segment_begin{0};
+      for (size_t level{0}; level < plans.size(); ++level) {
+        auto segment_end{
+            level < lods.size()
+                ? read_record<uint64_t>(
+                      bytes,
+                      segment_offset +
+                          (level * header.stream_count + stream_idx) *
+                              sizeof(uint64_t)
+                  )
+                : data.size()
+        };
+        if (segment_end < segment_begin || segment_end > data.size())
+          throw MeshFormatError("vertex segment out of bounds");
+
+        auto first{level_begin(level)};
+        auto count{level_end(level) - first};
+        plans[level].vertices.push_back({
+            data.subspan(segment_begin, segment_end - segment_begin),
+            decoded.subspan(first * stride, count * stride),
+            count,
+            stride,
+        });
+        segment_begin = segment_end;
+      }
+      data = decoded;
+    } else {
+      for (size_t level{0}; level < plans.size(); ++level) {
+        auto begin{std::min(level_begin(level) * stride, data.size())};
+        auto end{std::min(level_end(level) * stride, data.size())};
+        plans[level].populate.push_back(
+            {stream.data.offset + begin, end - begin}
+        );
+      }
+    }
+    if (data.size() < stream_size(format, header.vertex_count))
+      throw MeshFormatError("vertex stream smaller than vertex count");
+
+    mesh.streams.emplace_back(std::move(format), data);
+  }
+
+  if (header.index_type != 0) {
+    mesh.indices = read_index_blob(
+        asset,
+        header.indices,
+        header.index_count,
+        read_index_type(header.index_type),
+        compressed,
+        mesh,
+        finest
+    );
+  }
+
+  for (size_t lod_idx{0}; lod_idx < lods.size(); ++lod_idx) {
+    const auto &lod{lods[lod_idx]};
+    mesh.lods.push_back(LodData{
+        .vertex_count = lod.vertex_count,
+        .index_count = lod.index_count,
+        .indices = read_index_blob(
+            asset,
+            lod.indices,
+            lod.index_count,
+            read_index_type(lod.index_type),
+            compressed,
+            mesh,
+            plans[lod_idx]
+        ),
+    });
+  }
+
+  if (header.flags & dmesh::has_meshlets) {
+    auto record{read_record<dmesh::Meshlets>(
+        bytes,
+        sizeof(dmesh::Header) + header.stream_count * sizeof(dmesh::Stream)
+    )};
+
+    // sizes are checked here, contents once the finest level is read
+    MeshletData meshlets{
+        .count = record.count,
+        .ranges = payload(bytes, record.ranges),
+        .spheres = payload(bytes, record.spheres),
+        .cones = payload(bytes, record.cones),
+        .vertices = payload(bytes, record.vertices),
+        .triangles = payload(bytes, record.triangles),
+    };
+    constexpr size_t vec4_size{16};
+    if (meshlets.count > bytes.size() / vec4_size ||
+        meshlets.ranges.size() < meshlets.count * vec4_size ||
+        meshlets.spheres.size() < meshlets.count * vec4_size ||
+        meshlets.cones.size() < meshlets.count * vec4_size)
+      throw MeshFormatError("meshlet arrays smaller than meshlet count");
+
+    mesh.meshlets = meshlets;
+    std::array ranges{
+        record.ranges,
+        record.spheres,
+        record.cones,
+        record.vertices,
+        record.triangles,
+    };
+    for (const auto &range : ranges)
+      finest.populate.push_back(range);
+  }
+
+  mesh.storage.push_back(asset.owner());
+  return MeshLevelReader{
+      std::move(mesh),
+      [asset, plans = std::move(plans)](size_t level) {
+        const auto &plan{plans[level]};
+        for (const auto &range : plan.populate)
+          asset.populate(range.offset, range.size);
+        for (const auto &segment : plan.vertices) {
+          decode_vertex_stream(
+              segment.out,
+              segment.count,
+              segment.stride,
+              segment.encoded
+          );
+        }
+        for (const auto &segment : plan.indices)
+          decode_index_stream(
+              segment.out,
+              segment.count,
+              segment.type,
+              segment.encoded
+          );
+      }
+  };
+}
+
+MeshData read_dmesh(const Asset &asset) {
+  auto reader{read_dmesh_levels(asset)};
+  while (reader.levels_read() < reader.level_count())
+    reader.read_next_level();
+  return std::move(reader).take();
+}
+
+// encodes the vertices of every level on its own, so levels decode
+// independently, and appends where each level ends in the blob to `ends`
+static std::vector<std::byte> encode_segments(
+    const VertexStreamData &stream,
+    std::span<const size_t> level_ends,
+    std::vector<uint64_t> &ends
+) {
+  std::vector<std::byte> blob;
+  auto stride{stream.format.stride};
+  size_t first{0};
+  for (auto last : level_ends) {
+    // bytes past the end of the stream read as zero
+    auto begin{std::min(first * stride, stream.bytes.size())};
+    auto segment{
+        encode_vertex_stream(stream.bytes.subspan(begin), last - first, stride)
+    };
+    blob.insert(blob.end(), segment.begin(), segment.end());
+    ends.push_back(blob.size());
+    first = last;
+  }
+  ends.pop_back();
+  return blob;
+}
+
+GeometrySize
+write_dmesh(std::ostream &out, const MeshData &mesh, bool compress) {
+  if (mesh.streams.size() > UINT32_MAX)
+    throw MeshFormatError("too many vertex streams");
+  if (mesh.lods.size() > UINT32_MAX)
+    throw MeshFormatError("too many levels of detail");
+
+  // vertex counts of every level, coarse to fine, the mesh itself last
+  std::vector<size_t> level_ends;
+  for (const auto &lod : mesh.lods)
+    level_ends.push_back(lod.vertex_count);
+  level_ends.push_back(mesh.vertex_count);
+
+  // blobs as they are stored, encoded up front so the layout knows their size
+  std::vector<std::span<const std::byte>> stream_blobs;
+  for (const auto &stream : mesh.streams)
+    stream_blobs.push_back(stream.bytes);
+  std::span<const std::byte> index_blob;
+  if (mesh.indices)
+    index_blob = mesh.indices->bytes;
+  std::vector<std::span<const std::byte>> lod_blobs;
+  for (const auto &lod : mesh.lods)
+    lod_blobs.push_back(lod.indices.bytes);
+
+  // ends of every level but the finest within each stream, level major
+  std::vector<uint64_t> segment_ends(mesh.lods.size() * mesh.streams.size());
+  auto raw_segment_ends = [&] {
+    for (size_t level{0}; level < mesh.lods.size(); ++level) {
+      for (size_t stream_idx{0}; stream_idx < mesh.streams.size();
+           ++stream_idx) {
+        const auto &stream{mesh.streams[stream_idx]};
+        segment_ends[level * mesh.streams.size() + stream_idx] = std::min(
+            level_ends[level] * stream.format.stride,
+            stream.bytes.size()
+        );
+      }
+    }
+  };
+  raw_segment_ends();
+
+  auto blob_size = [&] {
+    auto size{index_blob.size()};
+    for (auto blob : stream_blobs)
+      size += blob.size();
+    for (auto blob : lod_blobs)
+      size += blob.size();
+    return size;
+  };
+  GeometrySize geometry{.raw = blob_size(), .stored = 0};
+
+  std::vector<std::vector<std::byte>> encoded;
+  if (compress) {
+    // spans refer into `encoded`, so it must not reallocate
+    encoded.reserve(mesh.streams.size() + 1 + mesh.lods.size());
+    auto raw_streams{stream_blobs};
+    auto raw_indices{index_blob};
+    auto raw_lods{lod_blobs};
+    for (size_t stream_idx{0}; stream_idx < mesh.streams.size(); ++stream_idx) {
+      std::vector<uint64_t> ends;
+      stream_blobs[stream_idx] = encoded.emplace_back(
+          encode_segments(mesh.streams[stream_idx], level_ends, ends)
+      );
+      for (size_t level{0}; level < ends.size(); ++level)
+        segment_ends[level * mesh.streams.size() + stream_idx] = ends[level];
+    }
+    if (mesh.indices) {
+      index_blob = encoded.emplace_back(encode_index_stream(
+          mesh.indices->bytes,
+          mesh.index_count,
+          mesh.indices->type
+      ));
+    }
+    for (size_t lod_idx{0}; lod_idx < mesh.lods.size(); ++lod_idx) {
+      const auto &lod{mesh.lods[lod_idx]};
+      lod_blobs[lod_idx] = encoded.emplace_back(encode_index_stream(
+          lod.indices.bytes,
+          lod.index_count,
+          lod.indices.type
+      ));
+    }
+
+    // tiny meshes do not amortize the block headers
+    if (blob_size() >= geometry.raw) {
+      compress = false;
+      stream_blobs = std::move(raw_streams);
+      index_blob = raw_indices;
+      lod_blobs = std::move(raw_lods);
+      raw_segment_ends();
+    }
+  }
+  geometry.stored = blob_size();
+
+  dmesh::Header header{
+      .magic = dmesh::magic,
+      .version = dmesh::version,
+      .primitive = static_cast<uint32_t>(mesh.primitive),
+      .index_type = 0,
+      .vertex_count = mesh.vertex_count,
+      .index_count = mesh.index_count,
+      .indices = {},
+      .stream_count = static_cast<uint32_t>(mesh.streams.size()),
+      .flags = (mesh.meshlets ? dmesh::has_meshlets : 0) |
+               (compress ? dmesh::compressed_geometry : 0),
+      .lod_count = static_cast<uint32_t>(mesh.lods.size()),
+      .padding = 0,
+  };
+
+  // lay out payload blobs after the header and record tables, coarse levels
+  // first so they are read before the rest of the file
+  auto offset{align_up(
+      sizeof(dmesh::Header) + mesh.streams.size() * sizeof(dmesh::Stream) +
+          (mesh.meshlets ? sizeof(dmesh::Meshlets) : 0) +
+          mesh.lods.size() * sizeof(dmesh::Lod) +
+          segment_ends.size() * sizeof(uint64_t),
+      dmesh::alignment
+  )};
+
+  std::vector<dmesh::Lod> lods;
+  lods.reserve(mesh.lods.size());
+  for (size_t lod_idx{0}; lod_idx < mesh.lods.size(); ++lod_idx) {
+    const auto &lod{mesh.lods[lod_idx]};
+    lods.push_back(dmesh::Lod{
+        .vertex_count = lod.vertex_count,
+        .index_count = lod.index_count,
+        .index_type = static_cast<uint32_t>(lod.indices.type),
+        .padding = 0,
+        .indices = {.offset = offset, .size = lod_blobs[lod_idx].size()},
+    });
+    offset = align_up(offset + lod_blobs[lod_idx].size(), dmesh::alignment);
+  }
+
+  std::vector<dmesh::Stream> streams;
+  streams.reserve(mesh.streams.size());
+  for (size_t stream_idx{0}; stream_idx < mesh.streams.size(); ++stream_idx) {
+    const auto &stream{mesh.streams[stream_idx]};
+    if (stream.format.attribs.size() > dmesh::max_attribs)
+      throw MeshFormatError("too many vertex attributes");
+
+    dmesh::Stream record{
+        .data = {.offset = offset, .size = stream_blobs[stream_idx].size()},
+        .stride = static_cast<uint32_t>(stream.format.stride),
+        .attrib_count = static_cast<uint32_t>(stream.format.attribs.size()),
+        .attribs = {},
+    };
+    for (size_t attrib_idx{0}; attrib_idx < stream.format.attribs.size();
+         ++attrib_idx) {
+      const auto &attrib{stream.format.attribs[attrib_idx]};
+      record.attribs[attrib_idx] = dmesh::Attrib{
+          .location = static_cast<uint32_t>(attrib.props.location),
+          .type = static_cast<uint32_t>(attrib.props.type),
+          .size = static_cast<uint32_t>(attrib.props.size),
+          .offset = static_cast<uint32_t>(attrib.offset),
+          .normalized = attrib.normalized,
+      };
+    }
+    streams.push_back(record);
+
+    offset = align_up(
+        offset + stream_blobs[stream_idx].size(),
+        dmesh::alignment
+    );
+  }
+
+  if (mesh.indices) {
+    header.index_type = static_cast<uint32_t>(mesh.indices->type);
+    header.indices = {.offset = offset, .size = index_blob.size()};
+    offset = align_up(offset + index_blob.size(), dmesh::alignment);
+  }
+
+  dmesh::Meshlets meshlets{};
+  std::array<std::span<const std::byte>, 5> meshlet_blobs;
+  if (mesh.meshlets) {
+    meshlet_blobs = {
+        mesh.meshlets->ranges,
+        mesh.meshlets->spheres,
+        mesh.meshlets->cones,
+        mesh.meshlets->vertices,
+        mesh.meshlets->triangles,
+    };
+    std::array<dmesh::Range *, 5> ranges{
+        &meshlets.ranges,
+        &meshlets.spheres,
+        &meshlets.cones,
+        &meshlets.vertices,
+        &meshlets.triangles,
+    };
+
+    meshlets.count = mesh.meshlets->count;
+    for (size_t blob_idx{0}; blob_idx < meshlet_blobs.size(); ++blob_idx) {
+      *ranges[blob_idx] = {
+          .offset = offset,
+          .size = meshlet_blobs[blob_idx].size(),
+      };
+      offset = align_up(
+          offset + meshlet_blobs[blob_idx].size(),
+          dmesh::alignment
+      );
+    }
+  }
+
+  // emit records and blobs in the order they were laid out
+  size_t written{0};
+  auto write = [&](const void *data, size_t size) {
+    out.write(
+        static_cast<const char *>(data),
+        static_cast<std::streamsize>(size)
+    );
+    written += size;
+  };
+  auto pad_to = [&](size_t target) {
+    static constexpr std::array<char, dmesh::alignment> zeros{};
+    while (written < target)
+      write(zeros.data(), std::min(target - written, zeros.size()));
+  };
+
+  write(&header, sizeof(header));
+  write(streams.data(), streams.size() * sizeof(dmesh::Stream));
+  if (mesh.meshlets)
+    write(&meshlets, sizeof(meshlets));
+  write(lods.data(), lods.size() * sizeof(dmesh::Lod));
+  write(segment_ends.data(), segment_ends.size() * sizeof(uint64_t));
+
+  for (size_t lod_idx{0}; lod_idx < lods.size(); ++lod_idx) {
+    pad_to(lods[lod_idx].indices.offset);
+    write(lod_blobs[lod_idx].data(), lod_blobs[lod_idx].size());
+  }
+
+  for (size_t stream_idx{0}; stream_idx < streams.size(); ++stream_idx) {
+    pad_to(streams[stream_idx].data.offset);
+    write(stream_blobs[stream_idx].data(), stream_blobs[stream_idx].size());
+  }
+
+  if (mesh.indices) {
+    pad_to(header.indices.offset);
+    write(index_blob.data(), index_blob.size());
+  }
+
+  if (mesh.meshlets) {
+    std::array<uint64_t, 5> offsets{
+        meshlets.ranges.offset,
+        meshlets.spheres.offset,
+        meshlets.cones.offset,
+        meshlets.vertices.offset,
+        meshlets.triangles.offset,
+    };
+    for (size_t blob_idx{0}; blob_idx < meshlet_blobs.size(); ++blob_idx) {
+      pad_to(offsets[blob_idx]);
+      write(meshlet_blobs[blob_idx].data(), meshlet_blobs[blob_idx].size());
+    }
+  }
+
+  if (!out)
+    throw std::runtime_error("Failed to write mesh file");
+  return geometry;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <format>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include "file.h"
+#include "mesh.h"
+
+// Binary GPU-ready mesh container (.dmesh)
+//
+// Layout:
+//   Header
+//   Stream[header.stream_count]
+//   Meshlets, when header.flags has has_meshlets
+//   Lod[header.lod_count], coarse to fine
+//   uint64_t segment_ends[header.lod_count][header.stream_count]
+//   payload blobs, each aligned to dmesh::alignment
+//
+// Payload blobs hold vertex, index and meshlet data byte-for-byte as they are
+// handed to gl::Buffer::allocate_storage, so loading is a map and a bounds
+// check. With compressed_geometry the vertex and index blobs are codec streams
+// instead, decoded on the loading thread into the buffers that are uploaded.
+// All values are stored little-endian.
+//
+// Coarser levels of detail use a prefix of the vertices, see LodData. Their
+// index blobs come first, and every vertex stream is split into one segment
+// per level, which segment_ends delimits within the stream blob, so a level
+// is read or decoded without touching finer ones.
+namespace dmesh {
+constexpr std::array<char, 4> magic{'D', 'M', 'S', 'H'};
+constexpr uint32_t version{4};
+constexpr size_t max_attribs{8};
+constexpr size_t alignment{16};
+
+// Header::flags
+constexpr uint32_t has_meshlets{1 << 0};
+// vertex streams and indices are encoded with the geometry codec
+constexpr uint32_t compressed_geometry{1 << 1};
+
+// byte range relative to the start of the file
+struct Range {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct Attrib {
+  uint32_t location;
+  uint32_t type;
+  uint32_t size;
+  uint32_t offset;
+  uint32_t normalized;
+};
+
+struct Stream {
+  Range data;
+  uint32_t stride;
+  uint32_t attrib_count;
+  std::array<Attrib, max_attribs> attribs;
+};
+
+struct Header {
+  std::array<char, 4> magic;
+  uint32_t version;
+  uint32_t primitive;
+  // zero for non-indexed meshes
+  uint32_t index_type;
+  uint64_t vertex_count;
+  uint64_t index_count;
+  Range indices;
+  uint32_t stream_count;
+  uint32_t flags;
+  uint32_t lod_count;
+  uint32_t padding;
+};
+
+struct Lod {
+  uint64_t vertex_count;
+  uint64_t index_count;
+  uint32_t index_type;
+  uint32_t padding;
+  Range indices;
+};
+
+// blobs of the MeshletData arrays
+struct Meshlets {
+  uint64_t count;
+  Range ranges;
+  Range spheres;
+  Range cones;
+  Range vertices;
+  Range triangles;
+};
+
+static_assert(sizeof(Attrib) == 20);
+static_assert(sizeof(Stream) == 184);
+static_assert(sizeof(Header) == 64);
+static_assert(sizeof(Meshlets) == 88);
+static_assert(sizeof(Lod) == 40);
+} // namespace dmesh
+
+class MeshFormatError : public std::runtime_error {
+public:
+  explicit MeshFormatError(const std::string &reason)
+      : std::runtime_error(std::format("Invalid mesh file: {}", reason)) {}
+};
+
+// Validates a mapped .dmesh file and returns views into its payload
+// The returned MeshData keeps the asset's mapping alive.
+MeshData read_dmesh(const Asset &asset);
+
+// Validates the tables of a mapped .dmesh file without reading any level
+MeshLevelReader read_dmesh_levels(const Asset &asset);
+
+// vertex and index bytes before and after encoding
+struct GeometrySize {
+  size_t raw{0};
+  size_t stored{0};
+};
+
+// Serializes mesh contents into the .dmesh layout, encoding vertex and index
+// streams when `compress` is set and that makes them smaller
+GeometrySize
+write_dmesh(std::ostream &out, const MeshData &mesh, bool compress = false);
@@ -0,0 +1,205 @@
+#include "file.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static size_t page_size() {
+  static const auto size{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+  return size;
+}
+
+static int to_advice(FileAccess access) {
+  switch (access) {
+  case FileAccess::sequential:
+    return MADV_SEQUENTIAL;
+  case FileAccess::random:
+    return MADV_RANDOM;
+  default:
+    return MADV_NORMAL;
+  }
+}
+
+MappedFile::MappedFile(const fs::path &path, FileAccess access) {
+  auto fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd < 0) {
+    throw std::runtime_error(std::format(
+        "Failed to open file {}: {}",
+        absolute(path).string(),
+        std::strerror(errno)
+    ));
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    auto error{errno};
+    close(fd);
+    throw std::runtime_error(std::format(
+        "Failed to stat file {}: {}",
+        absolute(path).string(),
+        std::strerror(error)
+    ));
+  }
+
+  length = static_cast<size_t>(info.st_size);
+
+  // zero-length mappings are not allowed, an empty file is an empty view
+  if (length > 0) {
+    auto mapping{mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0)};
+    if (mapping == MAP_FAILED) {
+      auto error{errno};
+      close(fd);
+      throw std::runtime_error(std::format(
+          "Failed to map file {}: {}",
+          absolute(path).string(),
+          std::strerror(error)
+      ));
+    }
+
+    data = static_cast<std::byte *>(mapping);
+    // hints are best-effort, failure only affects readahead behaviour
+    madvise(data, length, to_advice(access));
+  }
+
+  // the mapping keeps its own reference to the file
+  close(fd);
+}
+
+std::string read_file(const fs::path &path) {
+  auto fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd < 0) {
+    throw std::runtime_error(std::format(
+        "Failed to open file {}: {}",
+        absolute(path).string(),
+        std::strerror(errno)
+    ));
+  }
+
+  // reads until end of file rather than trusting the size, the file may be
+  // changing underneath
+  std::string contents;
+  std::array<char, 1 << 16> buffer;
+  while (true) {
+    auto count{read(fd, buffer.data(), buffer.size())};
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count < 0) {
+      auto error{errno};
+      close(fd);
+      throw std::runtime_error(std::format(
+          "Failed to read file {}: {}",
+          absolute(path).string(),
+          std::strerror(error)
+      ));
+    }
+    if (count == 0)
+      break;
+    contents.append(buffer.data(), static_cast<size_t>(count));
+  }
+
+  close(fd);
+  return contents;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data(other.data), length(other.length) {
+  other.data = nullptr;
+  other.length = 0;
+}
+
+MappedFile::~MappedFile() {
+  if (data)
+    munmap(data, length);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  // unmap this object's view
+  if (data)
+    munmap(data, length);
+
+  // move mapping out of other and into this
+  data = other.data;
+  length = other.length;
+  other.data = nullptr;
+  other.length = 0;
+
+  return *this;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+  if (!data || offset >= length)
+    return;
+
+  // madvise requires a page aligned start address
+  auto aligned_offset{offset & ~(page_size() - 1)};
+  auto end{std::min(offset + size, length)};
+
+  madvise(data + aligned_offset, end - aligned_offset, MADV_WILLNEED);
+}
+
+void MappedFile::release(size_t offset, size_t size) const {
+  if (!data || offset >= length)
+    return;
+
+  auto aligned_offset{offset & ~(page_size() - 1)};
+  auto end{std::min(offset + size, length)};
+
+  madvise(data + aligned_offset, end - aligned_offset, MADV_DONTNEED);
+}
+
+void MappedFile::populate() const { populate(0, length); }
+
+void MappedFile::populate(size_t offset, size_t size) const {
+  if (!data || offset >= length)
+    return;
+
+  auto aligned_offset{offset & ~(page_size() - 1)};
+  auto end{std::min(offset + size, length)};
+
+#ifdef MADV_POPULATE_READ
+  if (madvise(
+          data + aligned_offset,
+          end - aligned_offset,
+          MADV_POPULATE_READ
+      ) == 0)
+    return;
+#endif
+
+  // older kernels, touch a byte in every page instead
+  for (auto page{aligned_offset}; page < end; page += page_size())
+    static_cast<void>(*static_cast<const volatile std::byte *>(data + page));
+}
+
+Asset::Asset(std::shared_ptr<const MappedFile> file, size_t offset, size_t size)
+    : file(std::move(file)), offset(offset), length(size) {
+  if (offset > this->file->size() || size > this->file->size() - offset)
+    throw std::out_of_range("Asset range exceeds its file");
+}
+
+Asset::Asset(MappedFile file)
+    : file(std::make_shared<const MappedFile>(std::move(file))),
+      length(this->file->size()) {}
+
+void Asset::populate() const {
+  if (file)
+    file->populate(offset, length);
+}
+
+void Asset::populate(size_t range_offset, size_t size) const {
+  if (file && range_offset < length)
+    file->populate(
+        offset + range_offset,
+        std::min(size, length - range_offset)
+    );
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Access pattern hints forwarded to madvise
+enum class FileAccess {
+  normal,
+  sequential,
+  random,
+};
+
+// Read-only memory mapped view of a file
+// Exposes the file contents without copying them into process memory, pages
+// are faulted in from the page cache on first access.
+class MappedFile {
+  std::byte *data{nullptr};
+  size_t length{0};
+
+public:
+  MappedFile() = default;
+  explicit MappedFile(
+      const std::filesystem::path &path,
+      FileAccess access = FileAccess::sequential
+  );
+  MappedFile(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  ~MappedFile();
+
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  // ask the kernel to start reading the given range ahead of use
+  void prefetch(size_t offset, size_t size) const;
+
+  // synchronously fault in every page, so later reads never block on I/O
+  void populate() const;
+  void populate(size_t offset, size_t size) const;
+
+  // drop resident pages of a range that has been consumed, later reads fault
+  // them back in from the page cache
+  void release(size_t offset, size_t size) const;
+
+  size_t size() const { return length; }
+  bool empty() const { return length == 0; }
+
+  std::span<const std::byte> bytes() const { return {data, length}; }
+
+  std::string_view text() const {
+    return {reinterpret_cast<const char *>(data), length};
+  }
+
+  // implicit conversion to a view of the file contents
+  operator std::string_view() const { return text(); }
+};
+
+// Copies the whole file into memory with read(2), for files that may be
+// rewritten in place while the contents are in use, which would fault a
+// mapping of them
+std::string read_file(const std::filesystem::path &path);
+
+// Bytes of one asset, a whole loose file or a blob inside a mapped pack
+// Copies share the mapping, which stays alive while any view of it does.
+class Asset {
+  std::shared_ptr<const MappedFile> file;
+  size_t offset{0};
+  size_t length{0};
+
+public:
+  Asset() = default;
+  Asset(std::shared_ptr<const MappedFile> file, size_t offset, size_t size);
+  explicit Asset(MappedFile file);
+
+  // fault in the pages of this asset only
+  void populate() const;
+  // fault in a range of this asset, offsets are relative to its start
+  void populate(size_t offset, size_t size) const;
+
+  // keeps the mapping alive, for holders of spans into bytes()
+  std::shared_ptr<const void> owner() const { return file; }
+
+  size_t size() const { return length; }
+  bool empty() const { return length == 0; }
+
+  std::span<const std::byte> bytes() const {
+    return file ? file->bytes().subspan(offset, length)
+                : std::span<const std::byte>{};
+  }
+
+  std::string_view text() const {
+    auto view{bytes()};
+    return {reinterpret_cast<const char *>(view.data()), view.size()};
+  }
+
+  // implicit conversion to a view of the asset contents
+  operator std::string_view() const { return text(); }
+};
@@ -29,9 +29,31 @@ void gl::Shader::add_source(string_view source) const {
   glShaderSource(handle, 1, &source_data, &length);
 }
 
+void gl::Shader::add_source(std::span<const string_view> chunks) const {
+  std::vector<const char *> sources;
+  std::vector<GLint> lengths;
+  sources.reserve(chunks.size());
+  lengths.reserve(chunks.size());
+  for (auto chunk : chunks) {
+    sources.push_back(chunk.data());
+    lengths.push_back(static_cast<GLint>(chunk.length()));
+  }
+  glShaderSource(
+      handle,
+      static_cast<GLsizei>(chunks.size()),
+      sources.data(),
+      lengths.data()
+  );
+}
+
 void gl::Shader::compile() const {
-  glCompileShader(handle);
+  begin_compile();
+  check_compiled();
+}
 
+void gl::Shader::begin_compile() const { glCompileShader(handle); }
+
+void gl::Shader::check_compiled() const {
   // retrieve compile status and check if it failed
   GLint compile_status;
   glGetShaderiv(handle, GL_COMPILE_STATUS, &compile_status);
@@ -79,10 +101,19 @@ void gl::Program::attach_shader(GLuint shader) const {
   glAttachShader(handle, shader);
 }
 
+void gl::Program::retain_binary() const {
+  glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
 void gl::Program::link() const {
-  glLinkProgram(handle);
+  begin_link();
+  check_linked();
+}
 
-  // retrieve compile status and check if it failed
+void gl::Program::begin_link() const { glLinkProgram(handle); }
+
+void gl::Program::check_linked() const {
+  // retrieve link status and check if it failed
   GLint link_status;
   glGetProgramiv(handle, GL_LINK_STATUS, &link_status);
 
@@ -104,8 +135,85 @@ void gl::Program::link() const {
   }
 }
 
+bool gl::Program::load_binary(
+    GLenum format,
+    std::span<const std::byte> binary
+) const {
+  glProgramBinary(
+      handle,
+      format,
+      binary.data(),
+      static_cast<GLsizei>(binary.size())
+  );
+
+  // a rejected binary is reported as a failed link, not a GL error
+  GLint link_status;
+  glGetProgramiv(handle, GL_LINK_STATUS, &link_status);
+  return link_status == GL_TRUE;
+}
+
+std::vector<std::byte> gl::Program::binary(GLenum &format) const {
+  GLint length;
+  glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+
+  std::vector<std::byte> binary(length);
+  if (length > 0) {
+    GLsizei actual_length;
+    glGetProgramBinary(handle, length, &actual_length, &format, binary.data());
+    binary.resize(actual_length);
+  }
+  return binary;
+}
+
 gl::Program::operator unsigned int() const { return handle; }
 
+void gl::enable_parallel_compile() {
+  if (GLAD_GL_KHR_parallel_shader_compile)
+    glMaxShaderCompilerThreadsKHR(0xffffffff);
+}
+
+gl::ProgramBuild::ProgramBuild(std::vector<Shader> shaders, bool retain_binary)
+    : shaders(std::move(shaders)) {
+  // issue everything up front, status is only queried once the driver is done
+  for (const auto &shader : this->shaders) {
+    shader.begin_compile();
+    program.attach_shader(shader);
+  }
+  if (retain_binary)
+    program.retain_binary();
+  program.begin_link();
+}
+
+gl::ProgramBuild::ProgramBuild(Program linked) : program(std::move(linked)) {}
+
+gl::BuildStatus gl::ProgramBuild::status() const {
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    GLint completed;
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+    if (completed != GL_TRUE)
+      return BuildStatus::pending;
+  }
+
+  GLint link_status;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  return link_status == GL_TRUE ? BuildStatus::ready : BuildStatus::failed;
+}
+
+gl::Program gl::ProgramBuild::finish() {
+  GLint link_status;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  if (link_status != GL_TRUE) {
+    // a failed compile also fails the link, report the root cause
+    for (const auto &shader : shaders)
+      shader.check_compiled();
+    program.check_linked();
+  }
+
+  // individual shaders will be deleted when they go out of scope
+  shaders.clear();
+  return std::move(program);
+}
+
 gl::Buffer::Buffer() { glCreateBuffers(1, &handle); }
 
 gl::Buffer::Buffer(Buffer &&other) noexcept : handle(other.handle) {
@@ -129,8 +237,120 @@ void gl::Buffer::upload_data(const void *ptr, size_t size, GLenum usage) const {
   glNamedBufferData(handle, static_cast<GLsizeiptr>(size), ptr, usage);
 }
 
+void gl::Buffer::allocate_storage(
+    const void *ptr,
+    size_t size,
+    GLbitfield flags
+) const {
+  if (size == 0) {
+    ptr = nullptr;
+    size = 1;
+  }
+  glNamedBufferStorage(handle, static_cast<GLsizeiptr>(size), ptr, flags);
+}
+
+void gl::Buffer::update_data(
+    size_t offset,
+    const void *ptr,
+    size_t size
+) const {
+  if (size == 0)
+    return;
+  glNamedBufferSubData(
+      handle,
+      static_cast<GLintptr>(offset),
+      static_cast<GLsizeiptr>(size),
+      ptr
+  );
+}
+
+void *gl::Buffer::map_bytes(
+    size_t offset,
+    size_t size,
+    GLbitfield access
+) const {
+  auto mapping{glMapNamedBufferRange(
+      handle,
+      static_cast<GLintptr>(offset),
+      static_cast<GLsizeiptr>(size),
+      access
+  )};
+  if (!mapping)
+    throw std::runtime_error(
+        std::format("Failed to map {} bytes of a buffer", size)
+    );
+  return mapping;
+}
+
+void gl::Buffer::flush_range(size_t offset, size_t size) const {
+  glFlushMappedNamedBufferRange(
+      handle,
+      static_cast<GLintptr>(offset),
+      static_cast<GLsizeiptr>(size)
+  );
+}
+
+void gl::Buffer::unmap() const { glUnmapNamedBuffer(handle); }
+
 gl::Buffer::operator unsigned int() const { return handle; }
 
+gl::Fence::Fence(Fence &&other) noexcept : handle(other.handle) {
+  other.handle = nullptr;
+}
+
+gl::Fence::~Fence() { glDeleteSync(handle); }
+
+gl::Fence &gl::Fence::operator=(Fence &&other) noexcept {
+  // delete this object's handle
+  glDeleteSync(handle);
+
+  // move handle out of other and into this
+  handle = other.handle;
+  other.handle = nullptr;
+
+  return *this;
+}
+
+void gl::Fence::insert() {
+  glDeleteSync(handle);
+  handle = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void gl::Fence::wait() const {
+  if (!handle)
+    return;
+
+  // the first wait flushes, so the fence is guaranteed to be reached
+  constexpr GLuint64 timeout{1'000'000'000};
+  GLbitfield flags{GL_SYNC_FLUSH_COMMANDS_BIT};
+  while (true) {
+    switch (glClientWaitSync(handle, flags, timeout)) {
+    case GL_ALREADY_SIGNALED:
+    case GL_CONDITION_SATISFIED:
+      return;
+    case GL_WAIT_FAILED:
+      throw std::runtime_error("Failed to wait on a fence");
+    default:
+      flags = 0;
+    }
+  }
+}
+
+bool gl::Fence::signaled() const {
+  if (!handle)
+    return true;
+
+  switch (glClientWaitSync(handle, GL_SYNC_FLUSH_COMMANDS_BIT, 0)) {
+  case GL_ALREADY_SIGNALED:
+  case GL_CONDITION_SATISFIED:
+    return true;
+  case GL_WAIT_FAILED:
+    throw std::runtime_error("Failed to query a fence");
+  default:
+    return false;
+  }
+}
+
 gl::VAO::VAO() { glCreateVertexArrays(1, &handle); }
 
 gl::VAO::VAO(VAO &&other) noexcept : handle(other.handle) { other.handle = 0; }
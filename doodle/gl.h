@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <format>
+#include <span>
 #include <stdexcept>
+#include <vector>
 
 #include <glad/gl.h>
 
@@ -31,9 +34,19 @@ public:
   Shader &operator=(Shader &&other) noexcept;
 
   void add_source(std::string_view source) const;
+  // sets the source as consecutive chunks, compiled as if concatenated
+  void add_source(std::span<const std::string_view> chunks) const;
 
+  // compiles and waits for the result, throws CompilationError
   void compile() const;
 
+  // issues the compile without waiting, the driver may run it on its own
+  // threads
+  void begin_compile() const;
+
+  // waits for the compile if still running, throws CompilationError
+  void check_compiled() const;
+
   // implicit conversion to GLuint OpenGL handle
   operator GLuint() const;
 };
@@ -52,15 +65,69 @@ public:
 
   void attach_shader(GLuint shader) const;
 
+  // lets binary() return the linked program, must precede link()
+  void retain_binary() const;
+
+  // links and waits for the result, throws LinkError
   void link() const;
 
+  // issues the link without waiting, see Shader::begin_compile()
+  void begin_link() const;
+
+  // waits for the link if still running, throws LinkError
+  void check_linked() const;
+
+  // links from a driver specific binary instead of shaders, returns false
+  // when the driver rejects it and leaves the program unlinked
+  bool load_binary(GLenum format, std::span<const std::byte> binary) const;
+
+  // binary of the linked program, empty when the driver offers none
+  std::vector<std::byte> binary(GLenum &format) const;
+
   // implicit conversion to GLuint OpenGL handle
   operator GLuint() const;
 };
 
+// Lets the driver compile shaders on as many threads as it likes, a no-op
+// without GL_KHR_parallel_shader_compile
+void enable_parallel_compile();
+
+enum class BuildStatus {
+  pending,
+  ready,
+  failed,
+};
+
+// Program whose compiles and link were issued but not yet confirmed
+// With GL_KHR_parallel_shader_compile status() polls without blocking, so the
+// driver builds while frames keep rendering. Without it status() waits for
+// the build like the synchronous path did.
+class ProgramBuild {
+  Program program;
+  std::vector<Shader> shaders;
+
+public:
+  // issues the compiles of shaders with sources and the link of a program
+  // with them attached
+  explicit ProgramBuild(
+      std::vector<Shader> shaders,
+      bool retain_binary = false
+  );
+  // adopts a program that was already linked, e.g. from a binary
+  explicit ProgramBuild(Program linked);
+
+  BuildStatus status() const;
+
+  // waits for the build if still running and returns the program, throws
+  // CompilationError for the first failed shader, otherwise LinkError
+  Program finish();
+};
+
 class Buffer {
   GLuint handle;
 
+  void *map_bytes(size_t offset, size_t size, GLbitfield access) const;
+
 public:
   Buffer();
   Buffer(const Buffer &) = delete;
@@ -71,7 +138,8 @@ public:
   Buffer &operator=(Buffer &&other) noexcept;
 
   // accept any contiguous range of data
-  void upload_data(std::ranges::contiguous_range auto data, GLenum usage) const {
+  void
+  upload_data(std::ranges::contiguous_range auto data, GLenum usage) const {
     // calculate buffer size in bytes
     auto size{
         std::ranges::size(data) *
@@ -84,10 +152,83 @@ public:
 
   void upload_data(const void* ptr, size_t size, GLenum usage) const;
 
+  // Allocates immutable storage holding `data`, `flags` are the
+  // GL_*_STORAGE_BIT and GL_MAP_*_BIT flags of glNamedBufferStorage
+  // Storage cannot be respecified afterwards, which lets the driver place it
+  // for its use. It cannot be empty either, an empty range allocates a byte.
+  void allocate_storage(
+      std::ranges::contiguous_range auto data,
+      GLbitfield flags
+  ) const {
+    auto size{
+        std::ranges::size(data) *
+        sizeof(std::ranges::range_value_t<decltype(data)>)
+    };
+    allocate_storage(std::ranges::cdata(data), size, flags);
+  }
+
+  // same as above, leaving the contents undefined when `ptr` is null
+  void allocate_storage(const void *ptr, size_t size, GLbitfield flags) const;
+
+  // Replaces the bytes at `offset` with `data`, immutable storage needs
+  // GL_DYNAMIC_STORAGE_BIT
+  void
+  update_data(size_t offset, std::ranges::contiguous_range auto data) const {
+    auto size{
+        std::ranges::size(data) *
+        sizeof(std::ranges::range_value_t<decltype(data)>)
+    };
+    update_data(offset, std::ranges::cdata(data), size);
+  }
+
+  void update_data(size_t offset, const void *ptr, size_t size) const;
+
+  // Maps `count` elements starting `offset` bytes into the buffer, `access`
+  // being the GL_MAP_*_BIT flags of glMapNamedBufferRange
+  // Throws std::runtime_error when the driver refuses the mapping.
+  template <typename T>
+  std::span<T> map_range(size_t offset, size_t count, GLbitfield access) const {
+    return {
+        static_cast<T *>(map_bytes(offset, count * sizeof(T), access)),
+        count
+    };
+  }
+
+  // makes writes to a range mapped with GL_MAP_FLUSH_EXPLICIT_BIT visible,
+  // `offset` is relative to the start of the mapped range
+  void flush_range(size_t offset, size_t size) const;
+
+  void unmap() const;
+
   // implicit conversion to GLuint OpenGL handle
   operator GLuint() const;
 };
 
+// Fence sync, signaled once the GPU executed every command issued before it
+class Fence {
+  GLsync handle{nullptr};
+
+public:
+  Fence() = default;
+  Fence(const Fence &) = delete;
+  Fence(Fence &&other) noexcept;
+  ~Fence();
+
+  Fence &operator=(const Fence &) = delete;
+  Fence &operator=(Fence &&other) noexcept;
+
+  // replaces the fence with one after the commands issued so far
+  void insert();
+
+  // blocks until signaled, returns at once when no fence was inserted
+  // Throws std::runtime_error when the wait fails.
+  void wait() const;
+
+  // whether the GPU reached the fence, true when no fence was inserted
+  // Flushes, so a fence that is polled will eventually signal.
+  bool signaled() const;
+};
+
 class VAO {
   GLuint handle{};
 
@@ -111,4 +252,11 @@ typedef struct {
   int baseVertex;
   uint baseInstance;
 } DrawElementsIndirectCommand;
+
+typedef struct {
+  uint count;
+  uint instanceCount;
+  uint first;
+  uint baseInstance;
+} DrawArraysIndirectCommand;
 } // namespace gl
@@ -0,0 +1,598 @@
+#include "gltf.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+
+#include "file.h"
+#include "json.h"
+
+namespace fs = std::filesystem;
+using std::string;
+using std::string_view;
+
+namespace {
+constexpr uint32_t glb_magic{0x46546c67};      // "glTF"
+constexpr uint32_t glb_json_chunk{0x4e4f534a}; // "JSON"
+constexpr uint32_t glb_bin_chunk{0x004e4942};  // "BIN\0"
+
+enum class ComponentType : int {
+  i8 = 5120,
+  u8 = 5121,
+  i16 = 5122,
+  u16 = 5123,
+  u32 = 5125,
+  f32 = 5126,
+};
+
+size_t component_size(ComponentType type) {
+  switch (type) {
+  case ComponentType::i8:
+  case ComponentType::u8:
+    return 1;
+  case ComponentType::i16:
+  case ComponentType::u16:
+    return 2;
+  case ComponentType::u32:
+  case ComponentType::f32:
+    return 4;
+  }
+  throw GltfError(std::format("unknown component type {}", int(type)));
+}
+
+size_t component_count(string_view type) {
+  if (type == "SCALAR")
+    return 1;
+  if (type == "VEC2")
+    return 2;
+  if (type == "VEC3")
+    return 3;
+  if (type == "VEC4")
+    return 4;
+  throw GltfError(std::format("unsupported accessor type {}", type));
+}
+
+std::optional<AttribLocation> attrib_location(string_view semantic) {
+  if (semantic == "POSITION")
+    return AttribLocation::position;
+  if (semantic == "NORMAL")
+    return AttribLocation::normal;
+  if (semantic == "TEXCOORD_0")
+    return AttribLocation::texcoord;
+  // attributes without a shader location are skipped
+  return std::nullopt;
+}
+
+struct BufferView {
+  std::span<const std::byte> bytes;
+  // zero when elements are tightly packed
+  size_t stride;
+};
+
+struct Accessor {
+  size_t view;
+  size_t offset;
+  size_t count;
+  ComponentType component_type;
+  size_t components;
+  bool normalized;
+
+  size_t element_size() const {
+    return component_size(component_type) * components;
+  }
+};
+
+std::vector<std::byte> decode_base64(string_view text) {
+  static constexpr auto table{[] {
+    std::array<int8_t, 256> table{};
+    table.fill(-1);
+    string_view alphabet{
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+    };
+    for (size_t idx{0}; idx < alphabet.size(); ++idx)
+      table[static_cast<uint8_t>(alphabet[idx])] = static_cast<int8_t>(idx);
+    return table;
+  }()};
+
+  std::vector<std::byte> out;
+  out.reserve(text.size() / 4 * 3);
+
+  uint32_t accumulator{0};
+  int bits{0};
+  for (auto c : text) {
+    if (c == '=')
+      break;
+
+    auto value{table[static_cast<uint8_t>(c)]};
+    if (value < 0)
+      throw GltfError("invalid base64 data");
+
+    accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<std::byte>((accumulator >> bits) & 0xff));
+    }
+  }
+  return out;
+}
+
+string decode_uri(string_view uri) {
+  string out;
+  out.reserve(uri.size());
+  for (size_t idx{0}; idx < uri.size(); ++idx) {
+    if (uri[idx] == '%') {
+      // a truncated escape is as invalid as one with other characters
+      auto digits{uri.substr(idx + 1, 2)};
+      unsigned char value;
+      auto [end, error]{std::from_chars(
+          digits.data(),
+          digits.data() + digits.size(),
+          value,
+          16
+      )};
+      if (digits.size() != 2 || error != std::errc{} ||
+          end != digits.data() + digits.size())
+        throw GltfError(std::format("invalid escape in uri '{}'", uri));
+      out.push_back(static_cast<char>(value));
+      idx += 2;
+    } else {
+      out.push_back(uri[idx]);
+    }
+  }
+  return out;
+}
+
+// JSON and binary chunk of a GLB container, or the text of a .gltf file
+struct Container {
+  string_view json;
+  std::span<const std::byte> bin;
+  bool glb{false};
+};
+
+Container split_container(std::span<const std::byte> bytes) {
+  // GLB container, a JSON chunk optionally followed by a binary chunk
+  uint32_t magic{0};
+  if (bytes.size() >= sizeof(magic))
+    std::memcpy(&magic, bytes.data(), sizeof(magic));
+
+  if (magic != glb_magic) {
+    return Container{
+        .json = {reinterpret_cast<const char *>(bytes.data()), bytes.size()},
+        .bin = {},
+        .glb = false,
+    };
+  }
+
+  std::array<uint32_t, 3> header;
+  if (bytes.size() < sizeof(header))
+    throw GltfError("truncated GLB header");
+  std::memcpy(header.data(), bytes.data(), sizeof(header));
+  if (header[1] != 2)
+    throw GltfError(std::format("unsupported GLB version {}", header[1]));
+
+  Container container{.glb = true};
+  auto offset{sizeof(header)};
+  auto end{std::min<size_t>(header[2], bytes.size())};
+  while (offset + 8 <= end) {
+    std::array<uint32_t, 2> chunk;
+    std::memcpy(chunk.data(), bytes.data() + offset, sizeof(chunk));
+    offset += sizeof(chunk);
+    if (offset + chunk[0] > end)
+      throw GltfError("GLB chunk out of bounds");
+
+    auto chunk_bytes{bytes.subspan(offset, chunk[0])};
+    if (chunk[1] == glb_json_chunk) {
+      container.json = {
+          reinterpret_cast<const char *>(chunk_bytes.data()),
+          chunk_bytes.size()
+      };
+    } else if (chunk[1] == glb_bin_chunk) {
+      container.bin = chunk_bytes;
+    }
+    // chunks are padded to four byte boundaries
+    offset += (chunk[0] + 3) & ~size_t{3};
+  }
+  return container;
+}
+
+// Parsed document with every buffer resolved to bytes in memory
+class Document {
+  fs::path base_path;
+  json::Value root;
+  std::vector<std::span<const std::byte>> buffers;
+  std::vector<BufferView> views;
+  std::vector<Accessor> accessors;
+
+  void load_buffers(std::span<const std::byte> glb_bin) {
+    auto buffer_list{root.find("buffers")};
+    if (!buffer_list)
+      return;
+
+    for (const auto &buffer : buffer_list->as_array()) {
+      auto length{static_cast<size_t>(buffer["byteLength"].as_number())};
+
+      std::span<const std::byte> bytes;
+      if (auto uri{buffer.find("uri")}) {
+        const auto &text{uri->as_string()};
+        if (text.starts_with("data:")) {
+          auto data_start{text.find(";base64,")};
+          if (data_start == string::npos)
+            throw GltfError("only base64 data URIs are supported");
+
+          auto decoded{std::make_shared<std::vector<std::byte>>(
+              decode_base64(string_view(text).substr(data_start + 8))
+          )};
+          bytes = *decoded;
+          storage.push_back(std::move(decoded));
+        } else {
+          auto file{std::make_shared<MappedFile>(base_path / decode_uri(text))};
+          file->populate();
+          bytes = file->bytes();
+          storage.push_back(std::move(file));
+        }
+      } else {
+        // buffer without uri refers to the GLB binary chunk
+        bytes = glb_bin;
+      }
+
+      if (bytes.size() < length)
+        throw GltfError("buffer is shorter than its byteLength");
+      buffers.push_back(bytes.first(length));
+    }
+  }
+
+  void load_views() {
+    auto view_list{root.find("bufferViews")};
+    if (!view_list)
+      return;
+
+    for (const auto &view : view_list->as_array()) {
+      auto buffer{static_cast<size_t>(view["buffer"].as_number())};
+      auto offset{static_cast<size_t>(view.number_or("byteOffset", 0))};
+      auto length{static_cast<size_t>(view["byteLength"].as_number())};
+
+      if (buffer >= buffers.size())
+        throw GltfError("buffer view references a missing buffer");
+      if (offset + length > buffers[buffer].size())
+        throw GltfError("buffer view out of bounds");
+
+      views.push_back(BufferView{
+          .bytes = buffers[buffer].subspan(offset, length),
+          .stride = static_cast<size_t>(view.number_or("byteStride", 0)),
+      });
+    }
+  }
+
+  void load_accessors() {
+    auto accessor_list{root.find("accessors")};
+    if (!accessor_list)
+      return;
+
+    for (const auto &accessor : accessor_list->as_array()) {
+      if (accessor.find("sparse"))
+        throw GltfError("sparse accessors are not supported");
+      if (!accessor.find("bufferView"))
+        throw GltfError("accessors without a buffer view are not supported");
+
+      Accessor record{
+          .view = static_cast<size_t>(accessor["bufferView"].as_number()),
+          .offset = static_cast<size_t>(accessor.number_or("byteOffset", 0)),
+          .count = static_cast<size_t>(accessor["count"].as_number()),
+          .component_type = static_cast<ComponentType>(
+              static_cast<int>(accessor["componentType"].as_number())
+          ),
+          .components = component_count(accessor["type"].as_string()),
+          .normalized = false,
+      };
+      if (auto normalized{accessor.find("normalized")})
+        record.normalized = normalized->as_bool();
+
+      // validate the last element lies inside the view
+      if (record.view >= views.size())
+        throw GltfError("accessor references a missing buffer view");
+      const auto &view{views[record.view]};
+      auto stride{view.stride ? view.stride : record.element_size()};
+      if (record.count > 0 && record.offset + (record.count - 1) * stride +
+                                      record.element_size() >
+                                  view.bytes.size())
+        throw GltfError("accessor out of bounds");
+
+      accessors.push_back(record);
+    }
+  }
+
+  const Accessor &accessor(const json::Value &index) const {
+    auto accessor_idx{static_cast<size_t>(index.as_number())};
+    if (accessor_idx >= accessors.size())
+      throw GltfError("primitive references a missing accessor");
+    return accessors[accessor_idx];
+  }
+
+  // converts an integer attribute to floats following the glTF normalization
+  // rules, this is the only path that copies vertex data
+  VertexStreamData convert_attrib(
+      const Accessor &accessor,
+      AttribLocation location,
+      std::vector<std::shared_ptr<const void>> &owned
+  ) const {
+    const auto &view{views[accessor.view]};
+    auto stride{view.stride ? view.stride : accessor.element_size()};
+
+    auto values{std::make_shared<std::vector<float>>(
+        accessor.count * accessor.components
+    )};
+    for (size_t vertex{0}; vertex < accessor.count; ++vertex) {
+      auto element{view.bytes.data() + accessor.offset + vertex * stride};
+      for (size_t component{0}; component < accessor.components; ++component) {
+        float value;
+        switch (accessor.component_type) {
+        case ComponentType::i8: {
+          int8_t raw;
+          std::memcpy(&raw, element + component, sizeof(raw));
+          value = accessor.normalized ? std::max(raw / 127.0f, -1.0f) : raw;
+          break;
+        }
+        case ComponentType::u8: {
+          uint8_t raw;
+          std::memcpy(&raw, element + component, sizeof(raw));
+          value = accessor.normalized ? raw / 255.0f : raw;
+          break;
+        }
+        case ComponentType::i16: {
+          int16_t raw;
+          std::memcpy(&raw, element + component * 2, sizeof(raw));
+          value = accessor.normalized ? std::max(raw / 32767.0f, -1.0f) : raw;
+          break;
+        }
+        case ComponentType::u16: {
+          uint16_t raw;
+          std::memcpy(&raw, element + component * 2, sizeof(raw));
+          value = accessor.normalized ? raw / 65535.0f : raw;
+          break;
+        }
+        case ComponentType::u32: {
+          uint32_t raw;
+          std::memcpy(&raw, element + component * 4, sizeof(raw));
+          value = static_cast<float>(raw);
+          break;
+        }
+        case ComponentType::f32:
+          std::memcpy(&value, element + component * 4, sizeof(value));
+          break;
+        }
+        (*values)[vertex * accessor.components + component] = value;
+      }
+    }
+
+    VertexStreamData stream{
+        .format =
+            VertexFormat{
+                .attribs = {VertexAttrib{
+                    .props =
+                        VertexAttribProps{
+                            .location = location,
+                            .type = AttribType::f32,
+                            .size = accessor.components,
+                        },
+                    .offset = 0,
+                    .normalized = false,
+                }},
+                .stride = accessor.components * sizeof(float),
+            },
+        .bytes = std::as_bytes(std::span(*values)),
+    };
+    owned.push_back(std::move(values));
+    return stream;
+  }
+
+public:
+  // mapped files and decoded data URIs the buffers point into
+  std::vector<std::shared_ptr<const void>> storage;
+
+  Document(const fs::path &path) : base_path(path.parent_path()) {
+    auto file{std::make_shared<MappedFile>(path)};
+    auto bytes{file->bytes()};
+    storage.push_back(file);
+
+    auto container{split_container(bytes)};
+    if (container.glb)
+      file->populate();
+
+    root = json::parse(container.json);
+    load_buffers(container.bin);
+    load_views();
+    load_accessors();
+  }
+
+  const json::Value &json() const { return root; }
+
+  MeshData decode_primitive(const json::Value &primitive) const {
+    if (primitive.number_or("mode", GL_TRIANGLES) != GL_TRIANGLES)
+      throw GltfError("only triangle list primitives are supported");
+
+    MeshData mesh{.primitive = Primitive::triangles};
+
+    // group float attributes by buffer view, interleaved views become a
+    // single stream referencing the buffer as-is
+    std::map<size_t, std::vector<std::pair<AttribLocation, const Accessor *>>>
+        view_attribs;
+    std::optional<size_t> vertex_count;
+    for (const auto &[semantic, index] :
+         primitive["attributes"].as_object()) {
+      auto location{attrib_location(semantic)};
+      if (!location)
+        continue;
+
+      const auto &attrib_accessor{accessor(index)};
+      if (vertex_count && *vertex_count != attrib_accessor.count)
+        throw GltfError("attribute counts differ within a primitive");
+      vertex_count = attrib_accessor.count;
+
+      if (attrib_accessor.component_type == ComponentType::f32) {
+        view_attribs[attrib_accessor.view].emplace_back(
+            *location,
+            &attrib_accessor
+        );
+      } else {
+        mesh.streams.push_back(
+            convert_attrib(attrib_accessor, *location, mesh.storage)
+        );
+      }
+    }
+    if (!vertex_count)
+      throw GltfError("primitive has no usable attributes");
+    mesh.vertex_count = *vertex_count;
+
+    for (const auto &[view_idx, attribs] : view_attribs) {
+      const auto &view{views[view_idx]};
+
+      auto make_attrib = [](AttribLocation location,
+                            const Accessor &attrib_accessor,
+                            size_t offset) {
+        return VertexAttrib{
+            .props =
+                VertexAttribProps{
+                    .location = location,
+                    .type = AttribType::f32,
+                    .size = attrib_accessor.components,
+                },
+            .offset = offset,
+            .normalized = false,
+        };
+      };
+
+      if (view.stride == 0) {
+        // tightly packed views hold one attribute after another
+        for (const auto &[location, attrib_accessor] : attribs) {
+          auto size{attrib_accessor->count * attrib_accessor->element_size()};
+          mesh.streams.push_back(VertexStreamData{
+              .format =
+                  VertexFormat{
+                      .attribs = {make_attrib(location, *attrib_accessor, 0)},
+                      .stride = attrib_accessor->element_size(),
+                  },
+              .bytes = view.bytes.subspan(attrib_accessor->offset, size),
+          });
+        }
+        continue;
+      }
+
+      // interleaved, attributes whose elements end within one stride of the
+      // first form a stream with offsets relative to it; the rest, e.g. of
+      // another mesh sharing the view, start further streams
+      auto sorted{attribs};
+      std::ranges::sort(sorted, {}, [](const auto &attrib) {
+        return attrib.second->offset;
+      });
+      for (size_t first{0}; first < sorted.size();) {
+        auto base{sorted[first].second->offset};
+        VertexFormat format{.stride = view.stride};
+        auto last{first};
+        for (; last < sorted.size(); ++last) {
+          const auto &[location, attrib_accessor]{sorted[last]};
+          auto offset{attrib_accessor->offset - base};
+          if (offset + attrib_accessor->element_size() > view.stride)
+            break;
+          format.attribs.push_back(
+              make_attrib(location, *attrib_accessor, offset)
+          );
+        }
+        if (last == first)
+          throw GltfError("attribute elements exceed their view's byteStride");
+
+        auto size{std::min(
+            view.bytes.size() - base,
+            stream_size(format, mesh.vertex_count)
+        )};
+        mesh.streams.push_back(VertexStreamData{
+            .format = std::move(format),
+            .bytes = view.bytes.subspan(base, size),
+        });
+        first = last;
+      }
+    }
+
+    if (auto indices{primitive.find("indices")}) {
+      const auto &index_accessor{accessor(*indices)};
+
+      IndexType type;
+      switch (index_accessor.component_type) {
+      case ComponentType::u8:
+        type = IndexType::u8;
+        break;
+      case ComponentType::u16:
+        type = IndexType::u16;
+        break;
+      case ComponentType::u32:
+        type = IndexType::u32;
+        break;
+      default:
+        throw GltfError("invalid index component type");
+      }
+
+      // index buffer views are never strided, upload them as-is
+      const auto &view{views[index_accessor.view]};
+      mesh.indices = IndexStreamData{
+          .type = type,
+          .bytes = view.bytes.subspan(
+              index_accessor.offset,
+              index_accessor.count * index_size(type)
+          ),
+      };
+      mesh.index_count = index_accessor.count;
+    }
+
+    // every mesh keeps the shared buffers alive alongside its own conversions
+    mesh.storage.insert(mesh.storage.end(), storage.begin(), storage.end());
+    return mesh;
+  }
+};
+} // namespace
+
+std::vector<fs::path> gltf_buffer_files(const fs::path &path) {
+  MappedFile file{path};
+  auto root{json::parse(split_container(file.bytes()).json)};
+
+  std::vector<fs::path> files;
+  if (auto buffer_list{root.find("buffers")}) {
+    for (const auto &buffer : buffer_list->as_array()) {
+      auto uri{buffer.find("uri")};
+      if (uri && !uri->as_string().starts_with("data:"))
+        files.push_back(path.parent_path() / decode_uri(uri->as_string()));
+    }
+  }
+  return files;
+}
+
+std::vector<MeshData> import_gltf(const fs::path &path, ThreadPool &pool) {
+  Document document{path};
+
+  // flatten primitives of every mesh so they can be decoded independently
+  std::vector<const json::Value *> primitives;
+  if (auto meshes{document.json().find("meshes")}) {
+    for (const auto &mesh : meshes->as_array()) {
+      for (const auto &primitive : mesh["primitives"].as_array())
+        primitives.push_back(&primitive);
+    }
+  }
+
+  std::vector<std::optional<MeshData>> decoded(primitives.size());
+  parallel_for(pool, primitives.size(), [&](size_t primitive_idx) {
+    decoded[primitive_idx] =
+        document.decode_primitive(*primitives[primitive_idx]);
+  });
+
+  std::vector<MeshData> meshes;
+  meshes.reserve(decoded.size());
+  for (auto &mesh : decoded)
+    meshes.push_back(std::move(*mesh));
+  return meshes;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "loader.h"
+#include "mesh.h"
+
+class GltfError : public std::runtime_error {
+public:
+  explicit GltfError(const std::string &reason)
+      : std::runtime_error(std::format("Failed to import glTF: {}", reason)) {}
+};
+
+// Imports every triangle primitive of a glTF 2.0 asset (.gltf or .glb)
+// Primitives are decoded in parallel on `pool`. Float attributes and indices
+// reference the mapped buffers directly, including interleaved buffer views,
+// only integer attributes are converted into owned float streams.
+std::vector<MeshData>
+import_gltf(const std::filesystem::path &path, ThreadPool &pool);
+
+// External buffer files a .gltf or .glb references, which an import reads
+// besides the file itself
+std::vector<std::filesystem::path>
+gltf_buffer_files(const std::filesystem::path &path);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+constexpr uint64_t fnv1a_basis{0xcbf29ce484222325};
+
+// 64-bit FNV-1a, a fast non-cryptographic hash for names and small keys
+// Passing a previous result as `hash` continues it over more bytes.
+constexpr uint64_t
+fnv1a(std::span<const std::byte> bytes, uint64_t hash = fnv1a_basis) {
+  for (auto byte : bytes) {
+    hash ^= static_cast<uint64_t>(byte);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+constexpr uint64_t fnv1a(std::string_view text, uint64_t hash = fnv1a_basis) {
+  for (auto character : text) {
+    hash ^= static_cast<unsigned char>(character);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
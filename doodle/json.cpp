@@ -0,0 +1,275 @@
+#include "json.h"
+
+#include <charconv>
+
+using std::string;
+using std::string_view;
+
+namespace {
+class Parser {
+  string_view text;
+  size_t position{0};
+
+  [[noreturn]] void fail(string_view reason) const {
+    throw json::ParseError(reason, position);
+  }
+
+  void skip_whitespace() {
+    while (position < text.size()) {
+      auto c{text[position]};
+      if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        break;
+      ++position;
+    }
+  }
+
+  char peek() {
+    skip_whitespace();
+    if (position >= text.size())
+      fail("unexpected end of input");
+    return text[position];
+  }
+
+  void expect(char c) {
+    if (peek() != c)
+      fail(std::format("expected '{}'", c));
+    ++position;
+  }
+
+  void expect_literal(string_view literal) {
+    if (text.substr(position, literal.size()) != literal)
+      fail(std::format("expected {}", literal));
+    position += literal.size();
+  }
+
+  static void append_utf8(string &out, uint32_t code_point) {
+    if (code_point < 0x80) {
+      out.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      out.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+      out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else if (code_point < 0x10000) {
+      out.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else {
+      out.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+  }
+
+  uint32_t parse_hex4() {
+    if (position + 4 > text.size())
+      fail("truncated unicode escape");
+
+    uint32_t value;
+    auto begin{text.data() + position};
+    auto [end, error]{std::from_chars(begin, begin + 4, value, 16)};
+    if (error != std::errc{} || end != begin + 4)
+      fail("invalid unicode escape");
+
+    position += 4;
+    return value;
+  }
+
+  string parse_string() {
+    expect('"');
+
+    string out;
+    while (true) {
+      if (position >= text.size())
+        fail("unterminated string");
+
+      auto c{text[position++]};
+      if (c == '"')
+        return out;
+      if (c != '\\') {
+        out.push_back(c);
+        continue;
+      }
+
+      if (position >= text.size())
+        fail("unterminated escape");
+      switch (text[position++]) {
+      case '"':
+        out.push_back('"');
+        break;
+      case '\\':
+        out.push_back('\\');
+        break;
+      case '/':
+        out.push_back('/');
+        break;
+      case 'b':
+        out.push_back('\b');
+        break;
+      case 'f':
+        out.push_back('\f');
+        break;
+      case 'n':
+        out.push_back('\n');
+        break;
+      case 'r':
+        out.push_back('\r');
+        break;
+      case 't':
+        out.push_back('\t');
+        break;
+      case 'u': {
+        auto code_point{parse_hex4()};
+        // combine surrogate pairs
+        if (code_point >= 0xd800 && code_point < 0xdc00 &&
+            text.substr(position, 2) == "\\u") {
+          position += 2;
+          auto low{parse_hex4()};
+          code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+        }
+        append_utf8(out, code_point);
+        break;
+      }
+      default:
+        fail("invalid escape");
+      }
+    }
+  }
+
+  double parse_number() {
+    auto begin{text.data() + position};
+    double value;
+    auto [end, error]{
+        std::from_chars(begin, text.data() + text.size(), value)
+    };
+    if (error != std::errc{})
+      fail("invalid number");
+
+    position += end - begin;
+    return value;
+  }
+
+  json::Value parse_array() {
+    expect('[');
+
+    json::Array array;
+    if (peek() == ']') {
+      ++position;
+      return array;
+    }
+
+    while (true) {
+      array.push_back(parse_value());
+      if (peek() == ']') {
+        ++position;
+        return array;
+      }
+      expect(',');
+    }
+  }
+
+  json::Value parse_object() {
+    expect('{');
+
+    json::Object object;
+    if (peek() == '}') {
+      ++position;
+      return object;
+    }
+
+    while (true) {
+      peek();
+      auto key{parse_string()};
+      expect(':');
+      object.emplace_back(std::move(key), parse_value());
+      if (peek() == '}') {
+        ++position;
+        return object;
+      }
+      expect(',');
+    }
+  }
+
+public:
+  explicit Parser(string_view text) : text(text) {}
+
+  json::Value parse_value() {
+    switch (peek()) {
+    case '{':
+      return parse_object();
+    case '[':
+      return parse_array();
+    case '"':
+      return parse_string();
+    case 't':
+      expect_literal("true");
+      return true;
+    case 'f':
+      expect_literal("false");
+      return false;
+    case 'n':
+      expect_literal("null");
+      return {};
+    default:
+      return parse_number();
+    }
+  }
+
+  json::Value parse_document() {
+    auto value{parse_value()};
+    skip_whitespace();
+    if (position != text.size())
+      fail("trailing characters");
+    return value;
+  }
+};
+
+template <typename T>
+const T &get(const auto &data, string_view expected) {
+  if (auto value{std::get_if<T>(&data)})
+    return *value;
+  throw std::runtime_error(std::format("JSON value is not {}", expected));
+}
+} // namespace
+
+bool json::Value::as_bool() const { return get<bool>(data, "a boolean"); }
+
+double json::Value::as_number() const { return get<double>(data, "a number"); }
+
+const string &json::Value::as_string() const {
+  return get<string>(data, "a string");
+}
+
+const json::Array &json::Value::as_array() const {
+  return get<Array>(data, "an array");
+}
+
+const json::Object &json::Value::as_object() const {
+  return get<Object>(data, "an object");
+}
+
+const json::Value *json::Value::find(string_view key) const {
+  auto object{std::get_if<Object>(&data)};
+  if (!object)
+    return nullptr;
+
+  for (const auto &[member_key, member] : *object) {
+    if (member_key == key)
+      return &member;
+  }
+  return nullptr;
+}
+
+const json::Value &json::Value::operator[](string_view key) const {
+  if (auto member{find(key)})
+    return *member;
+  throw std::runtime_error(std::format("JSON object has no member '{}'", key));
+}
+
+double json::Value::number_or(string_view key, double fallback) const {
+  auto member{find(key)};
+  return member ? member->as_number() : fallback;
+}
+
+json::Value json::parse(string_view text) {
+  return Parser(text).parse_document();
+}
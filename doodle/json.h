@@ -0,0 +1,63 @@
+#pragma once
+
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Minimal JSON document model, enough to read asset metadata such as glTF
+namespace json {
+class ParseError : public std::runtime_error {
+public:
+  ParseError(std::string_view reason, size_t offset)
+      : std::runtime_error(
+            std::format("Invalid JSON at offset {}: {}", offset, reason)
+        ) {}
+};
+
+class Value;
+
+using Array = std::vector<Value>;
+// members keep document order, objects in asset files are small enough for
+// linear lookup
+using Object = std::vector<std::pair<std::string, Value>>;
+
+class Value {
+  std::variant<std::nullptr_t, bool, double, std::string, Array, Object> data;
+
+public:
+  Value() : data(nullptr) {}
+  Value(bool value) : data(value) {}
+  Value(double value) : data(value) {}
+  Value(std::string value) : data(std::move(value)) {}
+  Value(Array value) : data(std::move(value)) {}
+  Value(Object value) : data(std::move(value)) {}
+
+  bool is_null() const { return std::holds_alternative<std::nullptr_t>(data); }
+  bool is_number() const { return std::holds_alternative<double>(data); }
+  bool is_string() const { return std::holds_alternative<std::string>(data); }
+  bool is_array() const { return std::holds_alternative<Array>(data); }
+  bool is_object() const { return std::holds_alternative<Object>(data); }
+
+  // typed accessors throw std::runtime_error on a type mismatch
+  bool as_bool() const;
+  double as_number() const;
+  const std::string &as_string() const;
+  const Array &as_array() const;
+  const Object &as_object() const;
+
+  // member lookup, returns nullptr when absent or when this is not an object
+  const Value *find(std::string_view key) const;
+
+  // member lookup, throws std::runtime_error when absent
+  const Value &operator[](std::string_view key) const;
+
+  // number member with a fallback for optional properties
+  double number_or(std::string_view key, double fallback) const;
+};
+
+Value parse(std::string_view text);
+} // namespace json
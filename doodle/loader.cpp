@@ -0,0 +1,99 @@
+#include "loader.h"
+
+ThreadPool::ThreadPool(size_t thread_count) {
+  workers.reserve(thread_count);
+  for (size_t worker_idx{0}; worker_idx < thread_count; ++worker_idx)
+    workers.emplace_back([this] { run(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  job_available.notify_all();
+  // jthreads join on destruction, after draining the remaining jobs
+}
+
+void ThreadPool::submit(Job job) {
+  {
+    std::lock_guard lock{mutex};
+    jobs.push_back(std::move(job));
+  }
+  job_available.notify_one();
+}
+
+void ThreadPool::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock lock{mutex};
+      job_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty())
+        return;
+
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+UploadQueue::UploadQueue(size_t capacity) : capacity(capacity) {}
+
+void UploadQueue::push(Job task) {
+  std::unique_lock lock{mutex};
+  not_full.wait(lock, [this] { return closed || tasks.size() < capacity; });
+  if (closed)
+    return;
+
+  tasks.push_back(std::move(task));
+}
+
+size_t UploadQueue::drain(std::chrono::steady_clock::duration budget) {
+  auto deadline{std::chrono::steady_clock::now() + budget};
+
+  size_t completed{0};
+  do {
+    Job task;
+    {
+      std::lock_guard lock{mutex};
+      if (tasks.empty())
+        break;
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    not_full.notify_one();
+
+    task();
+    ++completed;
+  } while (std::chrono::steady_clock::now() < deadline);
+
+  return completed;
+}
+
+void UploadQueue::close() {
+  {
+    std::lock_guard lock{mutex};
+    closed = true;
+    tasks.clear();
+  }
+  not_full.notify_all();
+}
+
+AssetLoader::AssetLoader(
+    size_t thread_count,
+    size_t max_pending_uploads,
+    size_t staging_size,
+    size_t copy_budget
+)
+    : uploads(max_pending_uploads), staging_queue(staging_size, copy_budget),
+      pool(thread_count) {}
+
+AssetLoader::~AssetLoader() {
+  // unblock workers waiting on a full queue or staging buffer before the
+  // pool joins them
+  uploads.close();
+  staging_queue.close();
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "staging.h"
+
+using Job = std::move_only_function<void()>;
+
+// Fixed size pool of worker threads running queued jobs in FIFO order
+class ThreadPool {
+  std::mutex mutex;
+  std::condition_variable job_available;
+  std::deque<Job> jobs;
+  bool stopping{false};
+  std::vector<std::jthread> workers;
+
+  void run();
+
+public:
+  explicit ThreadPool(size_t thread_count);
+  ThreadPool(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(Job job);
+
+  size_t size() const { return workers.size(); }
+};
+
+// Runs body(index) for every index in [0, count) across the pool
+// The calling thread takes part in the work and only waits for items, never
+// for helper jobs to be scheduled, so this is safe to call from a pool worker.
+// The first exception thrown by body is rethrown once all items finished.
+template <typename Body>
+void parallel_for(ThreadPool &pool, size_t count, Body &&body) {
+  if (count == 0)
+    return;
+
+  struct State {
+    std::remove_reference_t<Body> *body;
+    size_t count;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> finished{0};
+    std::mutex mutex;
+    std::condition_variable all_finished;
+    std::exception_ptr error;
+  };
+
+  auto state{std::make_shared<State>(&body, count)};
+  auto work = [](State &state) {
+    size_t index;
+    while ((index = state.next.fetch_add(1)) < state.count) {
+      try {
+        (*state.body)(index);
+      } catch (...) {
+        std::lock_guard lock{state.mutex};
+        if (!state.error)
+          state.error = std::current_exception();
+      }
+
+      if (state.finished.fetch_add(1) + 1 == state.count) {
+        std::lock_guard lock{state.mutex};
+        state.all_finished.notify_all();
+      }
+    }
+  };
+
+  // helpers that start after every item was claimed exit without touching
+  // body, the shared state keeps them safe after this function returns
+  auto helper_count{std::min(pool.size(), count - 1)};
+  for (size_t helper_idx{0}; helper_idx < helper_count; ++helper_idx)
+    pool.submit([state, work] { work(*state); });
+
+  work(*state);
+
+  std::unique_lock lock{state->mutex};
+  state->all_finished.wait(lock, [&] {
+    return state->finished.load() == state->count;
+  });
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+// Bounded queue of GL work produced by loader threads
+// Producers block while the queue is full, which caps the amount of decoded
+// payload memory waiting on the GL thread.
+class UploadQueue {
+  std::mutex mutex;
+  std::condition_variable not_full;
+  std::deque<Job> tasks;
+  size_t capacity;
+  bool closed{false};
+
+public:
+  explicit UploadQueue(size_t capacity);
+  UploadQueue(const UploadQueue &) = delete;
+
+  UploadQueue &operator=(const UploadQueue &) = delete;
+
+  // enqueues a task, dropping it if the queue has been closed
+  void push(Job task);
+
+  // runs queued tasks on the calling thread until the queue is empty or the
+  // budget is spent, at least one task runs per call to guarantee progress
+  size_t drain(std::chrono::steady_clock::duration budget);
+
+  // wakes blocked producers and rejects further tasks
+  void close();
+};
+
+// Splits asset loading into a CPU stage on worker threads and a GL stage on
+// the thread owning the context
+// Buffer contents go through the staging queue: the CPU stage writes them
+// into staging slices and the GL stage enqueues copies out of them, which
+// pump() issues within the per-frame copy budget.
+class AssetLoader {
+  UploadQueue uploads;
+  // outlives the workers, which may still be reserving or releasing slices
+  StagingQueue staging_queue;
+  ThreadPool pool;
+
+public:
+  AssetLoader(
+      size_t thread_count,
+      size_t max_pending_uploads,
+      size_t staging_size,
+      size_t copy_budget
+  );
+  ~AssetLoader();
+
+  // Runs `read` on a worker thread, then hands its result to `upload` on the
+  // GL thread during pump(). The returned future is ready once the copies
+  // `upload` enqueued have been issued, exceptions from either stage end up
+  // in it.
+  template <typename Read, typename Upload>
+  auto load(Read read, Upload upload) {
+    using Payload = std::invoke_result_t<Read &>;
+    using Result = std::invoke_result_t<Upload &, Payload &&>;
+
+    std::promise<Result> promise;
+    auto future{promise.get_future()};
+
+    pool.submit([this,
+                 read = std::move(read),
+                 upload = std::move(upload),
+                 promise = std::move(promise)]() mutable {
+      std::optional<Payload> payload;
+      try {
+        payload.emplace(read());
+      } catch (...) {
+        promise.set_exception(std::current_exception());
+        return;
+      }
+
+      uploads.push([this,
+                    payload = std::move(*payload),
+                    upload = std::move(upload),
+                    promise = std::move(promise)]() mutable {
+        // results are held back until their copies were issued, those of
+        // uploads that staged nothing are ready at once
+        auto copies{staging_queue.copies()};
+        try {
+          if constexpr (std::is_void_v<Result>) {
+            upload(std::move(payload));
+            if (staging_queue.copies() == copies) {
+              promise.set_value();
+            } else {
+              staging_queue.then([promise = std::move(promise)]() mutable {
+                promise.set_value();
+              });
+            }
+          } else {
+            auto result{upload(std::move(payload))};
+            if (staging_queue.copies() == copies) {
+              promise.set_value(std::move(result));
+            } else {
+              staging_queue.then([promise = std::move(promise),
+                                  result = std::move(result)]() mutable {
+                promise.set_value(std::move(result));
+              });
+            }
+          }
+        } catch (...) {
+          promise.set_exception(std::current_exception());
+        }
+      });
+    });
+
+    return future;
+  }
+
+  // completes pending GL stages within `budget` and issues staged copies,
+  // call once per frame from the GL thread
+  size_t pump(std::chrono::steady_clock::duration budget) {
+    auto completed{uploads.drain(budget)};
+    staging_queue.flush();
+    return completed;
+  }
+
+  ThreadPool &workers() { return pool; }
+
+  StagingQueue &staging() { return staging_queue; }
+};
+
+// non-blocking check whether a load has finished
+template <typename T>
+bool is_ready(const std::future<T> &future) {
+  return future.valid() &&
+         future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
@@ -0,0 +1,307 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "optimize.h"
+
+namespace {
+using Vec3 = std::array<float, 3>;
+
+// finest grid searched, in cells along the longest axis, cell keys take
+// 16 bits per axis
+constexpr uint32_t max_resolution{1 << 16};
+
+struct Bounds {
+  Vec3 min;
+  // longest axis, cells are cubes
+  float extent;
+};
+
+uint64_t
+cell_key(const Vec3 &position, const Bounds &bounds, uint32_t resolution) {
+  uint64_t key{0};
+  for (size_t axis{0}; axis < 3; ++axis) {
+    auto offset{
+        bounds.extent > 0.0f
+            ? (position[axis] - bounds.min[axis]) / bounds.extent *
+                  float(resolution)
+            : 0.0f
+    };
+    auto cell{std::min(
+        static_cast<uint64_t>(std::max(offset, 0.0f)),
+        uint64_t{resolution} - 1
+    )};
+    key = key * resolution + cell;
+  }
+  return key;
+}
+
+// numbers the cells of every vertex `indices` refer to, others get
+// UINT32_MAX; returns the number of cells in use
+uint32_t assign_cells(
+    std::span<const uint32_t> indices,
+    std::span<const Vec3> positions,
+    const Bounds &bounds,
+    uint32_t resolution,
+    std::vector<uint32_t> &cells
+) {
+  cells.assign(positions.size(), UINT32_MAX);
+  std::unordered_map<uint64_t, uint32_t> cell_ids;
+  for (auto index : indices) {
+    if (cells[index] != UINT32_MAX)
+      continue;
+
+    auto [cell, inserted]{cell_ids.try_emplace(
+        cell_key(positions[index], bounds, resolution),
+        static_cast<uint32_t>(cell_ids.size())
+    )};
+    cells[index] = cell->second;
+  }
+  return static_cast<uint32_t>(cell_ids.size());
+}
+
+// distinct triangles spanning three cells, which is what a level on this
+// grid keeps
+size_t surviving_triangles(
+    std::span<const uint32_t> indices,
+    std::span<const uint32_t> cells,
+    std::vector<std::array<uint32_t, 3>> &keys
+) {
+  keys.clear();
+  for (size_t corner{0}; corner + 2 < indices.size(); corner += 3) {
+    std::array<uint32_t, 3> key{
+        cells[indices[corner + 0]],
+        cells[indices[corner + 1]],
+        cells[indices[corner + 2]],
+    };
+    if (key[0] == key[1] || key[1] == key[2] || key[0] == key[2])
+      continue;
+    std::ranges::sort(key);
+    keys.push_back(key);
+  }
+  std::ranges::sort(keys);
+  return static_cast<size_t>(std::ranges::unique(keys).begin() - keys.begin());
+}
+
+// finest grid that keeps at most `target` triangles, a single cell keeps none
+uint32_t search_resolution(
+    std::span<const uint32_t> indices,
+    std::span<const Vec3> positions,
+    const Bounds &bounds,
+    size_t target,
+    std::vector<uint32_t> &cells
+) {
+  std::vector<std::array<uint32_t, 3>> keys;
+  uint32_t low{1};
+  uint32_t high{max_resolution};
+  while (low < high) {
+    auto middle{low + (high - low + 1) / 2};
+    assign_cells(indices, positions, bounds, middle, cells);
+    if (surviving_triangles(indices, cells, keys) <= target)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+  return low;
+}
+
+// moves every cell onto its vertex closest to the mean of the cell and drops
+// degenerate and repeated triangles, keeping the order of the rest
+std::vector<uint32_t> collapse(
+    std::span<const uint32_t> indices,
+    std::span<const Vec3> positions,
+    std::span<const uint32_t> cells,
+    uint32_t cell_count
+) {
+  std::vector<Vec3> means(cell_count, Vec3{});
+  std::vector<uint32_t> counts(cell_count, 0);
+  for (size_t vertex{0}; vertex < cells.size(); ++vertex) {
+    if (cells[vertex] == UINT32_MAX)
+      continue;
+    for (size_t axis{0}; axis < 3; ++axis)
+      means[cells[vertex]][axis] += positions[vertex][axis];
+    ++counts[cells[vertex]];
+  }
+  for (uint32_t cell{0}; cell < cell_count; ++cell) {
+    for (auto &axis : means[cell])
+      axis /= float(counts[cell]);
+  }
+
+  std::vector<uint32_t> representatives(cell_count, UINT32_MAX);
+  std::vector<float> distances(
+      cell_count,
+      std::numeric_limits<float>::infinity()
+  );
+  for (uint32_t vertex{0}; vertex < cells.size(); ++vertex) {
+    auto cell{cells[vertex]};
+    if (cell == UINT32_MAX)
+      continue;
+
+    float distance{0.0f};
+    for (size_t axis{0}; axis < 3; ++axis) {
+      auto delta{positions[vertex][axis] - means[cell][axis]};
+      distance += delta * delta;
+    }
+    if (distance < distances[cell]) {
+      distances[cell] = distance;
+      representatives[cell] = vertex;
+    }
+  }
+
+  // representatives differ per cell, so degenerate triangles are those
+  // within fewer than three cells
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (size_t corner{0}; corner + 2 < indices.size(); corner += 3) {
+    auto a{cells[indices[corner + 0]]};
+    auto b{cells[indices[corner + 1]]};
+    auto c{cells[indices[corner + 2]]};
+    if (a == b || b == c || a == c)
+      continue;
+    triangles.push_back({
+        representatives[a],
+        representatives[b],
+        representatives[c],
+    });
+  }
+
+  // repeated triangles are found by their sorted corners, whatever their
+  // winding, the first one is kept
+  std::vector<std::array<uint32_t, 3>> keys(triangles);
+  for (auto &key : keys)
+    std::ranges::sort(key);
+  std::vector<uint32_t> order(triangles.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, {}, [&](uint32_t triangle) {
+    return keys[triangle];
+  });
+
+  std::vector<bool> keep(triangles.size(), true);
+  for (size_t order_idx{1}; order_idx < order.size(); ++order_idx) {
+    if (keys[order[order_idx]] == keys[order[order_idx - 1]])
+      keep[order[order_idx]] = false;
+  }
+
+  std::vector<uint32_t> collapsed;
+  for (size_t triangle{0}; triangle < triangles.size(); ++triangle) {
+    if (keep[triangle]) {
+      const auto &corners{triangles[triangle]};
+      collapsed.insert(collapsed.end(), corners.begin(), corners.end());
+    }
+  }
+  return collapsed;
+}
+} // namespace
+
+LodReport build_lods(MeshData &mesh, const LodSettings &settings) {
+  if (!mesh.indices || mesh.primitive != Primitive::triangles)
+    throw std::runtime_error("Levels of detail need an indexed triangle list");
+
+  auto indices{decode_indices(*mesh.indices, mesh.index_count)};
+  auto positions{read_positions(mesh)};
+
+  Bounds bounds{.min = {}, .extent = 0.0f};
+  if (!positions.empty()) {
+    bounds.min = positions.front();
+    auto max{positions.front()};
+    for (const auto &position : positions) {
+      for (size_t axis{0}; axis < 3; ++axis) {
+        bounds.min[axis] = std::min(bounds.min[axis], position[axis]);
+        max[axis] = std::max(max[axis], position[axis]);
+      }
+    }
+    for (size_t axis{0}; axis < 3; ++axis)
+      bounds.extent = std::max(bounds.extent, max[axis] - bounds.min[axis]);
+  }
+
+  // fine to coarse, every level simplifies the one before it so it only
+  // refers to vertices the finer levels use as well
+  std::vector<std::vector<uint32_t>> levels;
+  levels.reserve(settings.max_levels);
+  std::vector<uint32_t> cells;
+  std::span<const uint32_t> source{indices};
+  while (levels.size() < settings.max_levels) {
+    auto target{
+        static_cast<size_t>(float(source.size() / 3) * settings.reduction)
+    };
+    if (target < settings.min_triangles)
+      break;
+
+    auto resolution{
+        search_resolution(source, positions, bounds, target, cells)
+    };
+    auto cell_count{assign_cells(source, positions, bounds, resolution, cells)};
+    auto level{collapse(source, positions, cells, cell_count)};
+    if (level.size() / 3 < settings.min_triangles)
+      break;
+
+    optimize_vertex_cache(level, mesh.vertex_count);
+    source = levels.emplace_back(std::move(level));
+  }
+  if (levels.empty()) {
+    mesh.lods.clear();
+    return LodReport{.triangle_counts = {mesh.index_count / 3}};
+  }
+  std::ranges::reverse(levels);
+
+  // number vertices by first use, coarse to fine, so each level is a prefix
+  std::vector<uint32_t> remap(mesh.vertex_count, UINT32_MAX);
+  uint32_t next{0};
+  auto renumber = [&](std::vector<uint32_t> &level) {
+    for (auto &index : level) {
+      if (remap[index] == UINT32_MAX)
+        remap[index] = next++;
+      index = remap[index];
+    }
+  };
+  std::vector<size_t> vertex_counts;
+  for (auto &level : levels) {
+    renumber(level);
+    vertex_counts.push_back(next);
+  }
+  renumber(indices);
+  // unreferenced vertices are kept, after every level
+  for (auto &index : remap) {
+    if (index == UINT32_MAX)
+      index = next++;
+  }
+
+  std::vector<std::shared_ptr<const void>> storage;
+  remap_vertex_streams(mesh, remap, mesh.vertex_count, storage);
+
+  auto encode = [&](std::span<const uint32_t> level, size_t vertex_count) {
+    auto type{narrowest_index_type(vertex_count)};
+    auto bytes{
+        std::make_shared<std::vector<std::byte>>(encode_indices(level, type))
+    };
+    IndexStreamData stream{.type = type, .bytes = *bytes};
+    storage.push_back(std::move(bytes));
+    return stream;
+  };
+
+  LodReport report;
+  mesh.lods.clear();
+  for (size_t level_idx{0}; level_idx < levels.size(); ++level_idx) {
+    const auto &level{levels[level_idx]};
+    mesh.lods.push_back(LodData{
+        .vertex_count = vertex_counts[level_idx],
+        .index_count = level.size(),
+        .indices = encode(level, vertex_counts[level_idx]),
+    });
+    report.triangle_counts.push_back(level.size() / 3);
+  }
+  mesh.indices = encode(indices, mesh.vertex_count);
+  report.triangle_counts.push_back(mesh.index_count / 3);
+
+  // meshlets refer to the old vertex order and storage
+  mesh.meshlets.reset();
+  mesh.storage = std::move(storage);
+  return report;
+}
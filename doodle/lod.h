@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+
+struct LodSettings {
+  // coarser levels below the mesh itself
+  size_t max_levels{3};
+  // triangles a level keeps of the next finer one
+  float reduction{0.25f};
+  // levels with fewer triangles are not generated
+  size_t min_triangles{64};
+};
+
+struct LodReport {
+  // triangles of every level, coarse to fine, the mesh itself last
+  std::vector<size_t> triangle_counts;
+};
+
+// Generates coarser levels of detail of an indexed triangle list into
+// mesh.lods and reorders the vertices to serve them as prefixes
+// Every level clusters the vertices of the next finer one on a uniform grid,
+// sized by a search for the reduction target, and keeps the vertex closest to
+// the mean of each cell, so a level only refers to vertices of the finer
+// ones. Vertices are then ordered by first use from the coarsest level to the
+// mesh itself. Triangle order within levels is kept or optimized for the
+// vertex cache, meshlets are dropped; build them afterwards.
+LodReport build_lods(MeshData &mesh, const LodSettings &settings = {});
@@ -0,0 +1,1081 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <numeric>
+#include <print>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "dmesh.h"
+#include "gltf.h"
+#include "obj.h"
+
+namespace fs = std::filesystem;
+
+std::vector<std::byte>
+encode_indices(std::span<const uint32_t> indices, IndexType type) {
+  auto size{index_size(type)};
+  std::vector<std::byte> bytes(indices.size() * size);
+  for (size_t idx{0}; idx < indices.size(); ++idx) {
+    auto out{bytes.data() + idx * size};
+    switch (type) {
+    case IndexType::u8:
+      *out = static_cast<std::byte>(indices[idx]);
+      break;
+    case IndexType::u16: {
+      auto value{static_cast<uint16_t>(indices[idx])};
+      std::memcpy(out, &value, sizeof(value));
+      break;
+    }
+    case IndexType::u32:
+      std::memcpy(out, &indices[idx], sizeof(uint32_t));
+      break;
+    }
+  }
+  return bytes;
+}
+
+std::vector<uint32_t>
+decode_indices(const IndexStreamData &indices, size_t count) {
+  auto size{index_size(indices.type)};
+  std::vector<uint32_t> values(count);
+  for (size_t idx{0}; idx < count; ++idx) {
+    auto in{indices.bytes.data() + idx * size};
+    switch (indices.type) {
+    case IndexType::u8:
+      values[idx] = static_cast<uint32_t>(*in);
+      break;
+    case IndexType::u16: {
+      uint16_t value;
+      std::memcpy(&value, in, sizeof(value));
+      values[idx] = value;
+      break;
+    }
+    case IndexType::u32:
+      std::memcpy(&values[idx], in, sizeof(uint32_t));
+      break;
+    }
+  }
+  return values;
+}
+
+std::vector<std::array<float, 3>> read_positions(const MeshData &mesh) {
+  for (const auto &stream : mesh.streams) {
+    for (const auto &attrib : stream.format.attribs) {
+      if (attrib.props.location != AttribLocation::position)
+        continue;
+
+      // positions may be stored in any attribute type, cooked meshes keep
+      // them in half floats when the error bound allows
+      std::vector<std::array<float, 3>> positions(mesh.vertex_count);
+      for (size_t vertex{0}; vertex < mesh.vertex_count; ++vertex) {
+        auto in{stream.bytes.data() + vertex * stream.format.stride +
+                attrib.offset};
+        auto value{decode_attrib(in, attrib)};
+        positions[vertex] = {value[0], value[1], value[2]};
+      }
+      return positions;
+    }
+  }
+  throw std::runtime_error("Mesh has no position attribute");
+}
+
+// reads the `idx`th 32-bit word of a blob, which may not be aligned
+static uint32_t read_word(std::span<const std::byte> bytes, size_t idx) {
+  uint32_t word;
+  std::memcpy(&word, bytes.data() + idx * sizeof(word), sizeof(word));
+  return word;
+}
+
+static void
+validate_meshlets(const MeshletData &meshlets, size_t vertex_count) {
+  constexpr size_t vec4_size{4 * sizeof(uint32_t)};
+  if (meshlets.ranges.size() < meshlets.count * vec4_size ||
+      meshlets.spheres.size() < meshlets.count * vec4_size ||
+      meshlets.cones.size() < meshlets.count * vec4_size)
+    throw std::runtime_error("Meshlet arrays smaller than meshlet count");
+
+  auto meshlet_vertices{meshlets.vertices.size() / sizeof(uint32_t)};
+  auto meshlet_triangles{meshlets.triangles.size() / sizeof(uint32_t)};
+  for (size_t meshlet{0}; meshlet < meshlets.count; ++meshlet) {
+    auto vertex_offset{read_word(meshlets.ranges, meshlet * 4 + 0)};
+    auto meshlet_vertex_count{read_word(meshlets.ranges, meshlet * 4 + 1)};
+    auto triangle_offset{read_word(meshlets.ranges, meshlet * 4 + 2)};
+    auto triangle_count{read_word(meshlets.ranges, meshlet * 4 + 3)};
+
+    if (meshlet_vertex_count > 256 ||
+        size_t{vertex_offset} + meshlet_vertex_count > meshlet_vertices ||
+        size_t{triangle_offset} + triangle_count > meshlet_triangles)
+      throw std::runtime_error(std::format("Meshlet {} out of range", meshlet));
+
+    for (uint32_t vertex{0}; vertex < meshlet_vertex_count; ++vertex) {
+      if (read_word(meshlets.vertices, vertex_offset + vertex) >= vertex_count)
+        throw std::runtime_error(std::format(
+            "Meshlet {} references a vertex out of range",
+            meshlet
+        ));
+    }
+    for (uint32_t triangle{0}; triangle < triangle_count; ++triangle) {
+      auto packed{read_word(meshlets.triangles, triangle_offset + triangle)};
+      for (size_t corner{0}; corner < 3; ++corner) {
+        if (((packed >> (corner * 8)) & 0xff) >= meshlet_vertex_count)
+          throw std::runtime_error(std::format(
+              "Meshlet {} triangle uses a vertex it does not hold",
+              meshlet
+          ));
+      }
+    }
+  }
+}
+
+void fit_index_type(MeshData &mesh) {
+  if (!mesh.indices)
+    return;
+
+  auto strips{mesh.primitive == Primitive::triangle_strip};
+  auto type{narrowest_index_type(mesh.vertex_count, strips)};
+  if (mesh.indices->type == type)
+    return;
+
+  auto indices{decode_indices(*mesh.indices, mesh.index_count)};
+  if (strips) {
+    // the restart index moves to the largest value of the new type
+    std::ranges::replace(
+        indices,
+        restart_index(mesh.indices->type),
+        restart_index(type)
+    );
+  }
+
+  auto bytes{
+      std::make_shared<std::vector<std::byte>>(encode_indices(indices, type))
+  };
+  mesh.indices = IndexStreamData{.type = type, .bytes = *bytes};
+  mesh.storage.push_back(std::move(bytes));
+}
+
+// a coarser level has to fit the vertex prefix of the next finer one
+static void validate_lod(const MeshData &mesh, size_t level) {
+  const auto &lod{mesh.lods[level]};
+  auto previous_count{level == 0 ? 0 : mesh.lods[level - 1].vertex_count};
+  if (lod.vertex_count < previous_count || lod.vertex_count > mesh.vertex_count)
+    throw std::runtime_error("Level of detail vertex counts out of order");
+  if (lod.indices.bytes.size() <
+      lod.index_count * index_size(lod.indices.type)) {
+    throw std::runtime_error(
+        "Level of detail index stream smaller than index count"
+    );
+  }
+  if (lod.index_count % 3 != 0) {
+    throw std::runtime_error(
+        "Level of detail index count is not a multiple of 3"
+    );
+  }
+
+  for (auto index : decode_indices(lod.indices, lod.index_count)) {
+    if (index >= lod.vertex_count) {
+      throw std::runtime_error(std::format(
+          "Level of detail index {} out of range of {} vertices",
+          index,
+          lod.vertex_count
+      ));
+    }
+  }
+}
+
+void validate_level(const MeshData &mesh, size_t level) {
+  if (level < mesh.lods.size()) {
+    validate_lod(mesh, level);
+    return;
+  }
+
+  if (mesh.meshlets)
+    validate_meshlets(*mesh.meshlets, mesh.vertex_count);
+  if (!mesh.indices)
+    return;
+
+  if (mesh.indices->bytes.size() <
+      mesh.index_count * index_size(mesh.indices->type))
+    throw std::runtime_error("Index stream smaller than index count");
+  if (mesh.primitive == Primitive::triangles && mesh.index_count % 3 != 0)
+    throw std::runtime_error("Triangle index count is not a multiple of 3");
+
+  // strips separate their runs with the restart index
+  auto strips{mesh.primitive == Primitive::triangle_strip};
+  auto restart{restart_index(mesh.indices->type)};
+  for (auto index : decode_indices(*mesh.indices, mesh.index_count)) {
+    if (strips && index == restart)
+      continue;
+    if (index >= mesh.vertex_count) {
+      throw std::runtime_error(std::format(
+          "Index {} out of range of {} vertices",
+          index,
+          mesh.vertex_count
+      ));
+    }
+  }
+}
+
+void validate_mesh(const MeshData &mesh) {
+  if (mesh.streams.empty())
+    throw std::runtime_error("Mesh has no vertex streams");
+
+  for (const auto &stream : mesh.streams) {
+    if (stream.bytes.size() < stream_size(stream.format, mesh.vertex_count))
+      throw std::runtime_error("Vertex stream smaller than vertex count");
+  }
+  for (size_t level{0}; level <= mesh.lods.size(); ++level)
+    validate_level(mesh, level);
+}
+
+MeshLevelReader::MeshLevelReader(MeshData mesh)
+    : mesh(std::move(mesh)), read_count(level_count()) {}
+
+MeshLevelReader::MeshLevelReader(MeshData mesh, ReadLevel read_level)
+    : mesh(std::move(mesh)), read_level(std::move(read_level)), read_count(0) {}
+
+void MeshLevelReader::read_next_level() {
+  if (read_count == level_count())
+    return;
+  // levels decoded from a .dmesh are checked before anything draws them
+  read_level(read_count);
+  validate_level(mesh, read_count);
+  ++read_count;
+}
+
+// what is drawn at a level of detail
+struct LevelView {
+  size_t vertex_count;
+  Primitive primitive;
+  const IndexStreamData *indices;
+  size_t index_count;
+};
+
+static LevelView level_view(const MeshData &data, size_t level) {
+  if (level > data.lods.size()) {
+    throw std::runtime_error(std::format(
+        "Mesh has no level of detail {}, only {}",
+        level,
+        data.lods.size() + 1
+    ));
+  }
+  if (level == data.lods.size()) {
+    return LevelView{
+        .vertex_count = data.vertex_count,
+        .primitive = data.primitive,
+        .indices = data.indices ? &*data.indices : nullptr,
+        .index_count = data.index_count,
+    };
+  }
+
+  const auto &lod{data.lods[level]};
+  return LevelView{
+      .vertex_count = lod.vertex_count,
+      .primitive = Primitive::triangles,
+      .indices = &lod.indices,
+      .index_count = lod.index_count,
+  };
+}
+
+// contents a level adds to the vertices before `first_vertex`, in staging
+// order: the vertices of every stream, the level's indices, then the
+// meshlets of the finest level
+static std::vector<std::span<const std::byte>>
+level_parts(const MeshData &data, size_t level, size_t first_vertex) {
+  auto view{level_view(data, level)};
+
+  std::vector<std::span<const std::byte>> parts;
+  for (const auto &stream : data.streams) {
+    auto stride{stream.format.stride};
+    auto begin{std::min(first_vertex * stride, stream.bytes.size())};
+    auto end{std::min(view.vertex_count * stride, stream.bytes.size())};
+    parts.push_back(stream.bytes.subspan(begin, end - begin));
+  }
+  if (view.indices)
+    parts.push_back(view.indices->bytes);
+  if (level == data.lods.size() && data.meshlets) {
+    const auto &meshlets{*data.meshlets};
+    parts.insert(
+        parts.end(),
+        {
+            meshlets.ranges,
+            meshlets.spheres,
+            meshlets.cones,
+            meshlets.vertices,
+            meshlets.triangles,
+        }
+    );
+  }
+  return parts;
+}
+
+// where a part of level_parts() goes
+struct PartDestination {
+  GLuint buffer;
+  size_t offset;
+};
+
+static std::vector<PartDestination> part_destinations(
+    std::span<const VertexBuffer> vertex_buffers,
+    const std::optional<IndexBuffer> &index_buffer,
+    const std::optional<MeshletBuffers> &meshlets,
+    size_t first_vertex
+) {
+  std::vector<PartDestination> destinations;
+  for (const auto &vertex_buffer : vertex_buffers) {
+    auto stride{vertex_buffer.format.stride};
+    destinations.push_back(PartDestination{
+        .buffer = vertex_buffer.block.buffer(),
+        .offset = vertex_buffer.block.offset() + first_vertex * stride,
+    });
+  }
+  if (index_buffer) {
+    destinations.push_back(PartDestination{
+        .buffer = index_buffer->block.buffer(),
+        .offset = index_buffer->block.offset(),
+    });
+  }
+  if (meshlets) {
+    std::array<GLuint, 5> buffers{
+        meshlets->ranges,
+        meshlets->spheres,
+        meshlets->cones,
+        meshlets->vertices,
+        meshlets->triangles,
+    };
+    for (auto buffer : buffers)
+      destinations.push_back(PartDestination{.buffer = buffer, .offset = 0});
+  }
+  return destinations;
+}
+
+static std::optional<IndexBuffer>
+allocate_indices(const LevelView &view, MeshArena &arena) {
+  if (!view.indices)
+    return std::nullopt;
+
+  // aligned to the index size, so the offset is a whole first index
+  auto type{view.indices->type};
+  auto size{view.indices->bytes.size()};
+  auto block{arena.indices.allocate(size, index_size(type))};
+  auto offset{block.offset()};
+  return IndexBuffer{.block = std::move(block), .offset = offset, .type = type};
+}
+
+static std::optional<MeshletBuffers>
+allocate_meshlets(const MeshData &data, size_t level) {
+  if (level != data.lods.size() || !data.meshlets)
+    return std::nullopt;
+
+  // only ever filled by buffer copies
+  constexpr GLbitfield flags{0};
+  const auto &source{*data.meshlets};
+  MeshletBuffers meshlets;
+  meshlets.count = source.count;
+  meshlets.ranges.allocate_storage(nullptr, source.ranges.size(), flags);
+  meshlets.spheres.allocate_storage(nullptr, source.spheres.size(), flags);
+  meshlets.cones.allocate_storage(nullptr, source.cones.size(), flags);
+  meshlets.vertices.allocate_storage(nullptr, source.vertices.size(), flags);
+  meshlets.triangles.allocate_storage(nullptr, source.triangles.size(), flags);
+  return meshlets;
+}
+
+// takes the blocks and buffers of a mesh drawing `level` and sets up its
+// VAO, leaving their contents to be written
+static Mesh create_mesh(
+    const MeshData &data,
+    const Material &material,
+    MeshArena &arena,
+    size_t level
+) {
+  auto view{level_view(data, level)};
+
+  // blocks hold every level, coarser ones leave room for the vertices finer
+  // ones add later; aligned to the stride, so a whole number of vertices
+  // precedes each block
+  std::vector<ArenaBlock> blocks;
+  blocks.reserve(data.streams.size());
+  for (const auto &stream : data.streams) {
+    auto alignment{std::lcm(stream.format.stride, size_t{4})};
+    blocks.push_back(arena.vertices.allocate(stream.bytes.size(), alignment));
+  }
+
+  // the vertex index of the earliest block, others bind at the offset that
+  // puts that vertex index at their start
+  size_t base_vertex{SIZE_MAX};
+  for (size_t stream_idx{0}; stream_idx < blocks.size(); ++stream_idx) {
+    auto stride{data.streams[stream_idx].format.stride};
+    base_vertex = std::min(base_vertex, blocks[stream_idx].offset() / stride);
+  }
+  if (blocks.empty())
+    base_vertex = 0;
+
+  std::vector<VertexBuffer> vertex_buffers;
+  vertex_buffers.reserve(data.streams.size());
+  for (size_t stream_idx{0}; stream_idx < blocks.size(); ++stream_idx) {
+    const auto &format{data.streams[stream_idx].format};
+    auto offset{blocks[stream_idx].offset() - base_vertex * format.stride};
+    vertex_buffers.emplace_back(std::move(blocks[stream_idx]), offset, format);
+  }
+
+  auto index_buffer{allocate_indices(view, arena)};
+
+  // setup VAO (vertex array object)
+  // VAO exposes binding indices for vertex buffers to supply data.
+  gl::VAO vao;
+  for (int buffer_idx{0}; buffer_idx < vertex_buffers.size(); ++buffer_idx) {
+    const auto &vertex_buffer{vertex_buffers[buffer_idx]};
+
+    // bind vertex buffer to its binding index
+    glVertexArrayVertexBuffer(
+        vao,
+        buffer_idx,
+        arena.vertices.buffer(),
+        vertex_buffer.offset,
+        vertex_buffer.format.stride
+    );
+
+    for (const auto &attrib : vertex_buffer.format.attribs) {
+      auto attrib_index{static_cast<GLuint>(attrib.props.location)};
+      auto attrib_type{static_cast<GLenum>(attrib.props.type)};
+      auto attrib_size{static_cast<GLint>(attrib.props.size)};
+
+      if (is_packed(attrib.props.type) && attrib_size != 4) {
+        throw std::runtime_error(std::format(
+            "Packed attribute at location {} must have 4 components",
+            attrib_index
+        ));
+      }
+
+      // configure the attrib and assign its binding index, normalized
+      // integer types are read as fixed point in [0, 1] or [-1, 1]
+      glEnableVertexArrayAttrib(vao, attrib_index);
+      glVertexArrayAttribBinding(vao, attrib_index, buffer_idx);
+      glVertexArrayAttribFormat(
+          vao,
+          attrib_index,
+          attrib_size,
+          attrib_type,
+          attrib.normalized,
+          attrib.offset
+      );
+    }
+  }
+
+  // levels switch index blocks within the same buffer
+  if (index_buffer)
+    glVertexArrayElementBuffer(vao, arena.indices.buffer());
+
+  return Mesh{
+      .material = material,
+      .vao = std::move(vao),
+      .vertex_buffers = std::move(vertex_buffers),
+      .base_vertex = base_vertex,
+      .vertex_count = view.vertex_count,
+      .primitive = view.primitive,
+      .index_buffer = std::move(index_buffer),
+      .index_count = view.index_count,
+      .meshlets = allocate_meshlets(data, level),
+      .level = level,
+      .level_count = data.lods.size() + 1,
+  };
+}
+
+// writes the parts into a temporary buffer and copies them from there into
+// their destinations, whose storage takes no client updates
+static void write_parts(
+    std::span<const std::span<const std::byte>> parts,
+    std::span<const PartDestination> destinations
+) {
+  size_t size{0};
+  for (const auto &part : parts)
+    size += part.size();
+  if (size == 0)
+    return;
+
+  // deleted right away, GL keeps it until the copies out of it executed
+  gl::Buffer source;
+  source.allocate_storage(nullptr, size, GL_DYNAMIC_STORAGE_BIT);
+  size_t offset{0};
+  for (size_t part_idx{0}; part_idx < parts.size(); ++part_idx) {
+    const auto &part{parts[part_idx]};
+    if (part.empty())
+      continue;
+    source.update_data(offset, part);
+    glCopyNamedBufferSubData(
+        source,
+        destinations[part_idx].buffer,
+        static_cast<GLintptr>(offset),
+        static_cast<GLintptr>(destinations[part_idx].offset),
+        static_cast<GLsizeiptr>(part.size())
+    );
+    offset += part.size();
+  }
+}
+
+// enqueues copies of the parts within the staged piece into their
+// destinations
+static void copy_parts(
+    StagingQueue &staging,
+    const StagedLevel &staged,
+    const MeshData &data,
+    std::span<const PartDestination> destinations
+) {
+  auto parts{level_parts(data, staged.level, staged.first_vertex)};
+  auto piece_end{staged.offset + staged.size};
+  size_t part_start{0};
+  for (size_t part_idx{0}; part_idx < parts.size(); ++part_idx) {
+    auto part_end{part_start + parts[part_idx].size()};
+    auto begin{std::clamp(staged.offset, part_start, part_end)};
+    auto end{std::clamp(piece_end, part_start, part_end)};
+    staging.copy(
+        staged.slice,
+        begin - staged.offset,
+        destinations[part_idx].buffer,
+        destinations[part_idx].offset + (begin - part_start),
+        end - begin
+    );
+    part_start = part_end;
+  }
+}
+
+Mesh upload_mesh(
+    const MeshData &data,
+    const Material &material,
+    MeshArena &arena
+) {
+  auto level{data.lods.size()};
+  auto mesh{create_mesh(data, material, arena, level)};
+  write_parts(
+      level_parts(data, level, 0),
+      part_destinations(
+          mesh.vertex_buffers,
+          mesh.index_buffer,
+          mesh.meshlets,
+          0
+      )
+  );
+  return mesh;
+}
+
+StagedLevel stage_level(
+    StagingQueue &staging,
+    const MeshData &data,
+    size_t level,
+    size_t first_vertex,
+    size_t offset
+) {
+  auto parts{level_parts(data, level, first_vertex)};
+  size_t level_size{0};
+  for (const auto &part : parts)
+    level_size += part.size();
+  if (offset > level_size)
+    throw std::runtime_error("Staged piece starts past the end of its level");
+
+  auto piece_size{std::max<size_t>(staging.size() / 4, 1)};
+  auto size{std::min(level_size - offset, piece_size)};
+  auto slice{staging.reserve(size)};
+  auto out{slice.bytes().begin()};
+  size_t part_start{0};
+  for (const auto &part : parts) {
+    auto part_end{part_start + part.size()};
+    auto begin{std::clamp(offset, part_start, part_end)};
+    auto end{std::clamp(offset + size, part_start, part_end)};
+    auto bytes{part.subspan(begin - part_start, end - begin)};
+    out = std::ranges::copy(bytes, out).out;
+    part_start = part_end;
+  }
+
+  return StagedLevel{
+      .level = level,
+      .first_vertex = first_vertex,
+      .offset = offset,
+      .size = size,
+      .last = offset + size == level_size,
+      .slice = std::move(slice),
+  };
+}
+
+Mesh upload_mesh(
+    const MeshData &data,
+    const Material &material,
+    MeshArena &arena,
+    StagedLevel staged,
+    StagingQueue &staging,
+    std::optional<PendingLevel> &pending
+) {
+  if (staged.first_vertex != 0 || staged.offset != 0)
+    throw std::runtime_error("Staged level lacks the vertices before it");
+
+  auto mesh{create_mesh(data, material, arena, staged.level)};
+  copy_parts(
+      staging,
+      staged,
+      data,
+      part_destinations(
+          mesh.vertex_buffers,
+          mesh.index_buffer,
+          mesh.meshlets,
+          0
+      )
+  );
+  if (!staged.last) {
+    // nothing is drawn until the rest of the level was copied
+    pending = PendingLevel{
+        .level = staged.level,
+        .first_vertex = 0,
+        .staged = staged.size,
+        .index_buffer = std::exchange(mesh.index_buffer, std::nullopt),
+        .meshlets = std::exchange(mesh.meshlets, std::nullopt),
+    };
+    mesh.vertex_count = 0;
+    mesh.index_count = 0;
+  }
+  return mesh;
+}
+
+void upload_next_level(
+    Mesh &mesh,
+    std::optional<PendingLevel> &pending,
+    const MeshData &data,
+    MeshArena &arena,
+    StagedLevel staged,
+    StagingQueue &staging
+) {
+  auto level{staged.level};
+  auto view{level_view(data, level)};
+  if (staged.offset == 0) {
+    if (pending || level != mesh.level + 1 ||
+        staged.first_vertex != mesh.vertex_count)
+      throw std::runtime_error("Staged level does not follow the drawn one");
+    pending = PendingLevel{
+        .level = level,
+        .first_vertex = staged.first_vertex,
+        .staged = 0,
+        .index_buffer = allocate_indices(view, arena),
+        .meshlets = allocate_meshlets(data, level),
+    };
+  } else if (!pending || level != pending->level ||
+             staged.first_vertex != pending->first_vertex ||
+             staged.offset != pending->staged) {
+    throw std::runtime_error(
+        "Staged piece does not continue the pending level"
+    );
+  }
+
+  copy_parts(
+      staging,
+      staged,
+      data,
+      part_destinations(
+          mesh.vertex_buffers,
+          pending->index_buffer,
+          pending->meshlets,
+          staged.first_vertex
+      )
+  );
+  pending->staged += staged.size;
+  if (!staged.last)
+    return;
+
+  // the drawn level reads neither the vertices added past it nor the new
+  // blocks, so it is drawn until the copies were issued; the previous index
+  // block is released then, later writes to it are ordered after the draws
+  // still reading it
+  staging.then([&mesh,
+                level,
+                vertex_count = view.vertex_count,
+                primitive = view.primitive,
+                index_count = view.index_count,
+                index_buffer = std::move(pending->index_buffer),
+                meshlets = std::move(pending->meshlets)]() mutable {
+    mesh.index_buffer = std::move(index_buffer);
+    if (meshlets)
+      mesh.meshlets = std::move(meshlets);
+    mesh.vertex_count = vertex_count;
+    mesh.primitive = primitive;
+    mesh.index_count = index_count;
+    mesh.level = level;
+  });
+  pending.reset();
+}
+
+static MeshData import_source(const fs::path &path, ThreadPool &pool) {
+  if (path.extension() == ".obj")
+    return import_obj(path, pool);
+
+  auto meshes{import_gltf(path, pool)};
+  if (meshes.size() != 1) {
+    throw std::runtime_error(std::format(
+        "{} contains {} primitives, cook it into separate meshes",
+        path.string(),
+        meshes.size()
+    ));
+  }
+  return std::move(meshes.front());
+}
+
+// imports are stored uncompressed, so a hit maps straight into the upload
+// without decoding
+static MeshData import_cached(
+    const fs::path &path,
+    ThreadPool &pool,
+    const CookCache &cache
+) {
+  std::vector<fs::path> sources{path};
+  if (path.extension() != ".obj") {
+    auto buffers{gltf_buffer_files(path)};
+    sources.insert(sources.end(), buffers.begin(), buffers.end());
+  }
+  auto key{cache.key(sources, std::format("import dmesh {}", dmesh::version))};
+
+  if (auto entry{cache.load(key)}) {
+    if (auto asset{entry->find("0")})
+      return read_dmesh(*asset);
+  }
+
+  auto mesh{import_source(path, pool)};
+  fit_index_type(mesh);
+
+  // a mesh the cache cannot hold is still returned
+  try {
+    std::ostringstream out;
+    write_dmesh(out, mesh);
+    auto blob{out.view()};
+    std::array outputs{PackInput{
+        .name = "0",
+        .bytes = std::as_bytes(std::span{blob}),
+    }};
+    cache.store(key, outputs);
+  } catch (const std::runtime_error &error) {
+    std::println(
+        stderr,
+        "Not caching import of {}: {}",
+        path.string(),
+        error.what()
+    );
+  }
+  return mesh;
+}
+
+static MeshData read_mesh_asset(
+    const AssetLibrary &assets,
+    std::string_view name,
+    ThreadPool &pool,
+    const CookCache *cache
+) {
+  auto mesh_name{std::format("{}.dmesh", name)};
+
+  // uncooked source assets, used when no .dmesh has been produced
+  if (!assets.contains(mesh_name)) {
+    for (auto extension : {"glb", "gltf", "obj"}) {
+      fs::path source_path{std::format("{}.{}", name, extension)};
+      if (!exists(source_path))
+        continue;
+      return cache ? import_cached(source_path, pool, *cache)
+                   : import_source(source_path, pool);
+    }
+  }
+
+  // faults pages in here so the upload never waits on the disk
+  return read_dmesh(assets.open(mesh_name));
+}
+
+MeshData
+read_mesh(const AssetLibrary &assets, std::string_view name, ThreadPool &pool) {
+  auto mesh{read_mesh_asset(assets, name, pool, nullptr)};
+  // a no-op for cooked meshes, which are written with the fitting type
+  fit_index_type(mesh);
+  return mesh;
+}
+
+MeshData read_mesh(
+    const AssetLibrary &assets,
+    std::string_view name,
+    ThreadPool &pool,
+    const CookCache &cache
+) {
+  auto mesh{read_mesh_asset(assets, name, pool, &cache)};
+  fit_index_type(mesh);
+  return mesh;
+}
+
+MeshLevelReader read_mesh_levels(
+    const AssetLibrary &assets,
+    std::string_view name,
+    ThreadPool &pool,
+    const CookCache &cache
+) {
+  auto mesh_name{std::format("{}.dmesh", name)};
+  if (!assets.contains(mesh_name))
+    return MeshLevelReader{read_mesh(assets, name, pool, cache)};
+
+  // cooked meshes are written with the fitting index types
+  auto reader{read_dmesh_levels(assets.open(mesh_name))};
+  reader.read_next_level();
+  return reader;
+}
+
+// a level read and staged by a loader thread
+struct StagedRead {
+  std::shared_ptr<MeshLevelReader> reader;
+  StagedLevel staged;
+};
+
+std::future<MeshStream> stream_mesh(
+    AssetLoader &loader,
+    MeshArena &arena,
+    const AssetLibrary &assets,
+    std::string name,
+    const Material &material,
+    const CookCache &cache
+) {
+  return loader.load(
+      [&loader, &assets, &cache, name = std::move(name)] {
+        auto reader{std::make_shared<MeshLevelReader>(
+            read_mesh_levels(assets, name, loader.workers(), cache)
+        )};
+        auto level{reader->levels_read() - 1};
+        auto staged{stage_level(loader.staging(), reader->data(), level, 0, 0)};
+        return StagedRead{
+            .reader = std::move(reader),
+            .staged = std::move(staged),
+        };
+      },
+      [&loader, &material, &arena](StagedRead read) {
+        std::optional<PendingLevel> pending;
+        auto mesh{upload_mesh(
+            read.reader->data(),
+            material,
+            arena,
+            std::move(read.staged),
+            loader.staging(),
+            pending
+        )};
+        return MeshStream{
+            .mesh = std::move(mesh),
+            .reader = std::move(read.reader),
+            .pending = std::move(pending),
+        };
+      }
+  );
+}
+
+std::future<void> stream_next_level(
+    AssetLoader &loader,
+    MeshArena &arena,
+    MeshStream &stream
+) {
+  // the rest of a level staged in pieces comes before the next level, whose
+  // vertices start after the ones drawn already
+  const auto &pending{stream.pending};
+  auto level{pending ? pending->level : stream.mesh.level + 1};
+  auto first_vertex{pending ? pending->first_vertex : stream.mesh.vertex_count};
+  auto offset{pending ? pending->staged : 0};
+  return loader.load(
+      [&loader, reader = stream.reader, level, first_vertex, offset] {
+        if (reader->levels_read() == level)
+          reader->read_next_level();
+        auto staged{stage_level(
+            loader.staging(),
+            reader->data(),
+            level,
+            first_vertex,
+            offset
+        )};
+        return StagedRead{
+            .reader = std::move(reader),
+            .staged = std::move(staged),
+        };
+      },
+      [&loader, &stream, &arena](StagedRead read) {
+        upload_next_level(
+            stream.mesh,
+            stream.pending,
+            read.reader->data(),
+            arena,
+            std::move(read.staged),
+            loader.staging()
+        );
+      }
+  );
+}
+
+Mesh load_mesh(
+    const AssetLibrary &assets,
+    std::string_view name,
+    const Material &material,
+    MeshArena &arena,
+    ThreadPool &pool
+) {
+  return upload_mesh(read_mesh(assets, name, pool), material, arena);
+}
+
+void check_vertex_inputs(const Mesh &mesh, const Shader &shader) {
+  const auto &layout{shader.layout};
+  for (const auto &input : layout.inputs) {
+    // attribs are set up with glVertexArrayAttribFormat, which converts every
+    // type to float, integer and double inputs need the I and L variants
+    if (!is_float_input(input.type)) {
+      throw std::runtime_error(std::format(
+          "Vertex input {} is not floating point",
+          layout.name(input.name)
+      ));
+    }
+
+    // matrices and arrays take consecutive locations
+    auto location_count{
+        input_locations(input.type) * std::max(input.array_size, 1)
+    };
+    for (GLint location_idx{0}; location_idx < location_count; ++location_idx) {
+      auto location{static_cast<GLuint>(input.location + location_idx)};
+      auto reads_location = [&](const VertexAttrib &attrib) {
+        return static_cast<GLuint>(attrib.props.location) == location;
+      };
+      auto supplied{std::ranges::any_of(
+          mesh.vertex_buffers,
+          [&](const VertexBuffer &buffer) {
+            return std::ranges::any_of(buffer.format.attribs, reads_location);
+          }
+      )};
+      if (!supplied) {
+        throw std::runtime_error(std::format(
+            "Mesh has no attribute for vertex input {} at location {}",
+            layout.name(input.name),
+            location
+        ));
+      }
+    }
+  }
+}
+
+// whether `a` and `b` draw with the same program and equivalent VAOs, the
+// same buffers bound at the same offsets in the same formats, so one
+// multi-draw through the VAO of either draws both
+static bool draws_with(const Mesh &a, const Mesh &b) {
+  if (a.material.shader.program != b.material.shader.program ||
+      a.primitive != b.primitive ||
+      a.index_buffer.has_value() != b.index_buffer.has_value())
+    return false;
+  if (a.index_buffer && (a.index_buffer->type != b.index_buffer->type ||
+                         a.index_buffer->block.buffer() !=
+                             b.index_buffer->block.buffer()))
+    return false;
+  return std::ranges::equal(
+      a.vertex_buffers,
+      b.vertex_buffers,
+      [](const VertexBuffer &lhs, const VertexBuffer &rhs) {
+        return lhs.block.buffer() == rhs.block.buffer() &&
+               lhs.offset == rhs.offset && lhs.format == rhs.format;
+      }
+  );
+}
+
+// issues one multi-draw for meshes that all draw_with() the first
+static void
+draw_batch(std::span<const Mesh *const> batch, StreamRing &commands) {
+  const auto &first{*batch.front()};
+  glUseProgram(first.material.shader.program);
+  glBindVertexArray(first.vao);
+
+  // commands are consumed by offset from the ring's buffer, the driver reads
+  // them there instead of copying them out of client memory
+  auto mode{static_cast<GLenum>(first.primitive)};
+  auto draw_count{static_cast<GLsizei>(batch.size())};
+  if (first.index_buffer) {
+    // lists may legitimately use the largest index value
+    if (first.primitive == Primitive::triangle_strip)
+      glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    else
+      glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+
+    auto type{first.index_buffer->type};
+    std::vector<gl::DrawElementsIndirectCommand> batch_commands;
+    batch_commands.reserve(batch.size());
+    for (const auto *mesh : batch) {
+      batch_commands.push_back(gl::DrawElementsIndirectCommand{
+          .count = static_cast<unsigned int>(mesh->index_count),
+          .instanceCount = 1,
+          .firstIndex = static_cast<unsigned int>(
+              mesh->index_buffer->offset / index_size(type)
+          ),
+          .baseVertex = static_cast<int>(mesh->base_vertex),
+          .baseInstance = 0,
+      });
+    }
+    auto slice{commands.write(std::as_bytes(std::span{batch_commands}))};
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, slice.buffer);
+    glMultiDrawElementsIndirect(
+        mode,
+        static_cast<GLenum>(type),
+        reinterpret_cast<const void *>(slice.offset),
+        draw_count,
+        0 // indicates structs are tightly packed
+    );
+  } else {
+    std::vector<gl::DrawArraysIndirectCommand> batch_commands;
+    batch_commands.reserve(batch.size());
+    for (const auto *mesh : batch) {
+      batch_commands.push_back(gl::DrawArraysIndirectCommand{
+          .count = static_cast<unsigned int>(mesh->vertex_count),
+          .instanceCount = 1,
+          .first = static_cast<unsigned int>(mesh->base_vertex),
+          .baseInstance = 0,
+      });
+    }
+    auto slice{commands.write(std::as_bytes(std::span{batch_commands}))};
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, slice.buffer);
+    glMultiDrawArraysIndirect(
+        mode,
+        reinterpret_cast<const void *>(slice.offset),
+        draw_count,
+        0
+    );
+  }
+}
+
+void draw_meshes(std::span<const Mesh *const> meshes, StreamRing &commands) {
+  // meshes that draw with each other, in the order their first one comes
+  std::vector<std::vector<const Mesh *>> batches;
+  for (const auto *mesh : meshes) {
+    // nothing is drawn while the first level is still being copied
+    if (mesh->vertex_count == 0)
+      continue;
+
+    auto batch{std::ranges::find_if(batches, [&](const auto &batch) {
+      return draws_with(*batch.front(), *mesh);
+    })};
+    if (batch == batches.end())
+      batches.push_back({mesh});
+    else
+      batch->push_back(mesh);
+  }
+
+  for (const auto &batch : batches)
+    draw_batch(batch, commands);
+}
+
+void bind_meshlets(const Mesh &mesh, GLuint first_binding) {
+  if (!mesh.meshlets)
+    throw std::runtime_error("Mesh has no meshlets");
+
+  const auto &meshlets{*mesh.meshlets};
+  std::array<GLuint, 5> buffers{
+      meshlets.ranges,
+      meshlets.spheres,
+      meshlets.cones,
+      meshlets.vertices,
+      meshlets.triangles,
+  };
+  glBindBuffersBase(
+      GL_SHADER_STORAGE_BUFFER,
+      first_binding,
+      static_cast<GLsizei>(buffers.size()),
+      buffers.data()
+  );
+}
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "assets.h"
+#include "cook_cache.h"
+#include "file.h"
+#include "gl.h"
+#include "loader.h"
+#include "shader.h"
+#include "staging.h"
+#include "stream_ring.h"
+#include "vertex.h"
+
+// Vertex and index storage shared by every mesh
+// Meshes own blocks of the two arenas and address them by offset, so every
+// mesh draws from the same two buffers.
+struct MeshArena {
+  BufferArena vertices;
+  BufferArena indices;
+
+  MeshArena(size_t vertex_capacity, size_t index_capacity)
+      : vertices(vertex_capacity), indices(index_capacity) {}
+};
+
+// Stream in the vertex arena, whose blocks are aligned to the stride so the
+// mesh can address them by base vertex
+struct VertexBuffer {
+  ArenaBlock block;
+  // binding offset, the block's offset less the mesh's base vertex
+  size_t offset;
+  VertexFormat format;
+};
+
+struct IndexBuffer {
+  ArenaBlock block;
+  // of the first index in the index arena, a multiple of the index size
+  size_t offset{0};
+  IndexType type{IndexType::u16};
+};
+
+// Meshlet arrays in shader storage buffers, see MeshletData for the layout
+struct MeshletBuffers {
+  gl::Buffer ranges;
+  gl::Buffer spheres;
+  gl::Buffer cones;
+  gl::Buffer vertices;
+  gl::Buffer triangles;
+  size_t count;
+};
+
+// Vertex buffers are sized for every level of detail up front, the vertex
+// count, primitive and index buffer are those of the level that is drawn.
+struct Mesh {
+  // should be an identifier for the material instead of a reference
+  const Material &material;
+  gl::VAO vao;
+  std::vector<VertexBuffer> vertex_buffers;
+  // added to every index, or the first vertex drawn without indices
+  size_t base_vertex{0};
+  size_t vertex_count;
+  Primitive primitive;
+  std::optional<IndexBuffer> index_buffer{std::nullopt};
+  size_t index_count;
+  std::optional<MeshletBuffers> meshlets{std::nullopt};
+  // drawn level of detail, coarse to fine, meshlets are only uploaded with
+  // the finest one
+  size_t level{0};
+  size_t level_count{1};
+};
+
+struct VertexStreamData {
+  VertexFormat format;
+  std::span<const std::byte> bytes;
+};
+
+struct IndexStreamData {
+  IndexType type;
+  std::span<const std::byte> bytes;
+};
+
+// Meshlet decomposition as flat structure-of-arrays blobs, each laid out
+// for a std430 shader storage block and uploaded as is
+// Culling only reads the bounds, drawing only the ranges and indices.
+struct MeshletData {
+  size_t count{0};
+  // uvec4 per meshlet {vertex offset, vertex count, triangle offset,
+  // triangle count}, offsets index into `vertices` and `triangles`
+  std::span<const std::byte> ranges;
+  // vec4 per meshlet, bounding sphere {centre, radius}
+  std::span<const std::byte> spheres;
+  // vec4 per meshlet, normal cone {axis, cutoff}
+  // Every triangle of a meshlet faces away from a camera at `eye` when
+  // dot(centre - eye, axis) >= cutoff * length(centre - eye) + radius.
+  std::span<const std::byte> cones;
+  // uint per meshlet vertex, the mesh vertex it refers to
+  std::span<const std::byte> vertices;
+  // uint per triangle, three meshlet vertex indices packed in 8 bits each
+  std::span<const std::byte> triangles;
+};
+
+// Level of detail coarser than the mesh, an indexed triangle list
+// Vertices are ordered so every level uses a prefix of the vertex streams
+// and a finer level extends the prefix of a coarser one, so levels can be
+// uploaded one after the other into the same buffers.
+struct LodData {
+  size_t vertex_count{0};
+  size_t index_count{0};
+  IndexStreamData indices;
+};
+
+// CPU side mesh contents, laid out exactly as they are uploaded to the GPU
+// Byte spans point into mapped files or decoded buffers, which are kept alive
+// by `storage` alongside them.
+struct MeshData {
+  Primitive primitive{Primitive::triangles};
+  size_t vertex_count{0};
+  std::vector<VertexStreamData> streams;
+  std::optional<IndexStreamData> indices{std::nullopt};
+  size_t index_count{0};
+  std::optional<MeshletData> meshlets{std::nullopt};
+  // coarser levels of detail, coarse to fine, the mesh itself is the finest
+  std::vector<LodData> lods;
+  std::vector<std::shared_ptr<const void>> storage;
+};
+
+// Mesh contents that become readable one level of detail at a time, coarse
+// to fine
+// data() describes every level from the start, but the bytes of a level are
+// only faulted in or decoded by read_next_level(), so the coarsest level of a
+// large mesh is ready long before the rest.
+class MeshLevelReader {
+public:
+  using ReadLevel = std::move_only_function<void(size_t level)>;
+
+private:
+  MeshData mesh;
+  ReadLevel read_level;
+  size_t read_count;
+
+public:
+  // contents that were read whole, every level is readable
+  explicit MeshLevelReader(MeshData mesh);
+  MeshLevelReader(MeshData mesh, ReadLevel read_level);
+
+  size_t level_count() const { return mesh.lods.size() + 1; }
+  size_t levels_read() const { return read_count; }
+
+  // safe off the GL thread, but not concurrently with itself
+  void read_next_level();
+
+  const MeshData &data() const { return mesh; }
+  MeshData take() && { return std::move(mesh); }
+};
+
+// Packs 32-bit indices into the byte layout of `type`
+std::vector<std::byte>
+encode_indices(std::span<const uint32_t> indices, IndexType type);
+
+// Widens an index stream back to 32-bit indices
+std::vector<uint32_t>
+decode_indices(const IndexStreamData &indices, size_t count);
+
+// Re-encodes the indices in narrowest_index_type for the vertex count when
+// they use another type, promoting u8 and narrowing oversized u32 indices
+void fit_index_type(MeshData &mesh);
+
+// Extracts float positions, one per vertex, from whichever stream holds them
+std::vector<std::array<float, 3>> read_positions(const MeshData &mesh);
+
+// Checks streams hold enough data and every index addresses a vertex
+// Throws std::runtime_error describing the first problem found.
+void validate_mesh(const MeshData &mesh);
+
+// Checks the indices and, for the finest level, meshlets a level of detail
+// draws with, throwing like validate_mesh
+void validate_level(const MeshData &mesh, size_t level);
+
+// Copies the mesh contents into blocks of the arena and sets up its VAO,
+// meshlets get buffers of their own
+// Copies through a temporary buffer, loads streamed through an AssetLoader
+// stage their contents instead. Throws ArenaFullError when the arena cannot fit
+// them.
+Mesh upload_mesh(
+    const MeshData &data,
+    const Material &material,
+    MeshArena &arena
+);
+
+// Piece of the contents a level of detail adds to a mesh, written into
+// staging memory
+struct StagedLevel {
+  size_t level;
+  // vertices before it are uploaded with coarser levels
+  size_t first_vertex;
+  // bytes of the level's contents before the piece and in it
+  size_t offset;
+  size_t size;
+  // whether the piece ends the level
+  bool last;
+  StagingSlice slice;
+};
+
+// Level whose pieces are still being copied, into blocks the mesh does not
+// draw from yet
+struct PendingLevel {
+  size_t level;
+  size_t first_vertex;
+  // bytes of the level staged so far, where its next piece starts
+  size_t staged;
+  std::optional<IndexBuffer> index_buffer;
+  std::optional<MeshletBuffers> meshlets;
+};
+
+// Copies the vertices of `level` from `first_vertex` on, its indices and,
+// for the finest level, the meshlets into a slice of `staging`, starting
+// `offset` bytes into them
+// Levels larger than a quarter of the staging buffer are staged in pieces of
+// that size, so any level streams and other loads still find room. Safe to
+// call off the GL thread, waits while the staging buffer is full.
+StagedLevel stage_level(
+    StagingQueue &staging,
+    const MeshData &data,
+    size_t level,
+    size_t first_vertex,
+    size_t offset
+);
+
+// Same as upload_mesh() above, drawing a staged level that starts at the
+// first vertex
+// The contents are copied by StagingQueue::flush(), the mesh must not be
+// drawn before. When the piece does not end the level, the mesh draws
+// nothing and `pending` takes the level until upload_next_level() copied the
+// rest. Finer levels are added with upload_next_level() as well.
+Mesh upload_mesh(
+    const MeshData &data,
+    const Material &material,
+    MeshArena &arena,
+    StagedLevel staged,
+    StagingQueue &staging,
+    std::optional<PendingLevel> &pending
+);
+
+// Enqueues the copies of a piece of the pending level, or of the first piece
+// of the level after the drawn one, and switches the mesh to the level once
+// the copies of its last piece were issued, `mesh` has to outlive that flush
+void upload_next_level(
+    Mesh &mesh,
+    std::optional<PendingLevel> &pending,
+    const MeshData &data,
+    MeshArena &arena,
+    StagedLevel staged,
+    StagingQueue &staging
+);
+
+// Maps and validates a mesh, safe to call off the GL thread
+// Looks up <name>.dmesh in `assets` and falls back to importing <name>.glb,
+// <name>.gltf or <name>.obj from disk when no cooked mesh exists, decoding on
+// `pool`. Indices are passed through fit_index_type.
+MeshData
+read_mesh(const AssetLibrary &assets, std::string_view name, ThreadPool &pool);
+
+// Same as above, imported source assets are served from and stored in
+// `cache`, so only changed sources are imported again
+MeshData read_mesh(
+    const AssetLibrary &assets,
+    std::string_view name,
+    ThreadPool &pool,
+    const CookCache &cache
+);
+
+// Opens a mesh for reading level by level and reads its coarsest level, safe
+// to call off the GL thread
+// Cooked meshes are read lazily, imported ones whole, see read_mesh.
+MeshLevelReader read_mesh_levels(
+    const AssetLibrary &assets,
+    std::string_view name,
+    ThreadPool &pool,
+    const CookCache &cache
+);
+
+// Mesh streamed in level of detail by level through an AssetLoader
+struct MeshStream {
+  Mesh mesh;
+  // contents of the levels still to upload, shared with their loads
+  std::shared_ptr<MeshLevelReader> reader;
+  std::optional<PendingLevel> pending{std::nullopt};
+
+  bool complete() const {
+    return !pending && mesh.level + 1 == mesh.level_count;
+  }
+};
+
+// Issues the load of a mesh, ready as soon as its coarsest level can be drawn
+// or, when that level takes several pieces, its first piece was copied
+std::future<MeshStream> stream_mesh(
+    AssetLoader &loader,
+    MeshArena &arena,
+    const AssetLibrary &assets,
+    std::string name,
+    const Material &material,
+    const CookCache &cache
+);
+
+// Issues the load of the next piece of an incomplete stream, ready once its
+// copies were issued, when it ends a level the mesh draws that level by then;
+// `stream` has to outlive the load
+std::future<void> stream_next_level(
+    AssetLoader &loader,
+    MeshArena &arena,
+    MeshStream &stream
+);
+
+// Loads a mesh from disk
+// should be properly handled by an asset loader
+Mesh load_mesh(
+    const AssetLibrary &assets,
+    std::string_view name,
+    const Material &material,
+    MeshArena &arena,
+    ThreadPool &pool
+);
+
+// Checks the mesh supplies every vertex input of the shader in a form the
+// VAO can feed it, once after either of them is (re)loaded
+// Throws std::runtime_error naming the first unmatched input.
+void check_vertex_inputs(const Mesh &mesh, const Shader &shader);
+
+// Draws the meshes with one multi-draw per program and vertex layout, whose
+// indirect commands are allocated together from the current frame of
+// `commands`, binding the ring's buffer to GL_DRAW_INDIRECT_BUFFER
+// Meshes batch when they share a program, primitive, index type and the
+// buffers, offsets and formats their VAOs bind; a batch draws through the VAO
+// of its first mesh.
+void draw_meshes(std::span<const Mesh *const> meshes, StreamRing &commands);
+
+// Binds the meshlet arrays to consecutive shader storage buffer bindings
+// starting at `first_binding`, in the order they are declared in
+// MeshletBuffers
+void bind_meshlets(const Mesh &mesh, GLuint first_binding);
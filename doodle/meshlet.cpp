@@ -0,0 +1,320 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+using Vec3 = std::array<float, 3>;
+using Vec4 = std::array<float, 4>;
+// {vertex offset, vertex count, triangle offset, triangle count}
+using Range = std::array<uint32_t, 4>;
+
+// triangles partitioned per parallel task, a meshlet never spans two chunks
+// so each chunk ends in at most one partially filled meshlet
+constexpr size_t chunk_triangles{1 << 16};
+// meshlets per parallel task when computing bounds
+constexpr size_t bounds_batch{256};
+
+struct Meshlets {
+  std::vector<Range> ranges;
+  std::vector<Vec4> spheres;
+  std::vector<Vec4> cones;
+  std::vector<uint32_t> vertices;
+  std::vector<uint32_t> triangles;
+};
+
+Vec3 operator-(const Vec3 &a, const Vec3 &b) {
+  return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+Vec3 cross(const Vec3 &a, const Vec3 &b) {
+  return {
+      a[1] * b[2] - a[2] * b[1],
+      a[2] * b[0] - a[0] * b[2],
+      a[0] * b[1] - a[1] * b[0],
+  };
+}
+
+float dot(const Vec3 &a, const Vec3 &b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+float length(const Vec3 &a) { return std::sqrt(dot(a, a)); }
+
+// meshlet vertex lookup, open addressing over mesh vertex indices
+// Twice the largest meshlet keeps probe sequences short, and clearing it per
+// meshlet costs less than a table sized to the whole mesh.
+class LocalVertices {
+  static constexpr size_t capacity{512};
+  static constexpr uint32_t empty{UINT32_MAX};
+  std::array<uint32_t, capacity> vertices;
+  std::array<uint8_t, capacity> locals;
+
+  size_t slot(uint32_t vertex) const {
+    auto slot{(vertex * 0x9e3779b1u) >> 23};
+    while (vertices[slot] != empty && vertices[slot] != vertex)
+      slot = (slot + 1) & (capacity - 1);
+    return slot;
+  }
+
+public:
+  LocalVertices() { clear(); }
+
+  void clear() { vertices.fill(empty); }
+
+  bool contains(uint32_t vertex) const {
+    return vertices[slot(vertex)] == vertex;
+  }
+
+  // returns the local index of `vertex`, assigning `next` when it is new
+  uint32_t insert(uint32_t vertex, uint32_t next, bool &inserted) {
+    auto found{slot(vertex)};
+    inserted = vertices[found] == empty;
+    if (inserted) {
+      vertices[found] = vertex;
+      locals[found] = static_cast<uint8_t>(next);
+    }
+    return locals[found];
+  }
+};
+
+// greedily fills meshlets with consecutive triangles until either limit is
+// reached
+void partition(
+    std::span<const uint32_t> indices,
+    const MeshletLimits &limits,
+    Meshlets &out
+) {
+  LocalVertices local_vertices;
+  Range current{0, 0, 0, 0};
+  auto flush = [&] {
+    if (current[3] == 0)
+      return;
+    out.ranges.push_back(current);
+    current = {
+        static_cast<uint32_t>(out.vertices.size()),
+        0,
+        static_cast<uint32_t>(out.triangles.size()),
+        0,
+    };
+    local_vertices.clear();
+  };
+
+  for (size_t first{0}; first + 2 < indices.size(); first += 3) {
+    const auto *corners{indices.data() + first};
+
+    size_t new_vertices{0};
+    for (size_t corner{0}; corner < 3; ++corner) {
+      auto repeated{
+          std::find(corners, corners + corner, corners[corner]) !=
+          corners + corner
+      };
+      if (!repeated && !local_vertices.contains(corners[corner]))
+        ++new_vertices;
+    }
+    if (current[1] + new_vertices > limits.max_vertices ||
+        current[3] == limits.max_triangles)
+      flush();
+
+    uint32_t packed{0};
+    for (size_t corner{0}; corner < 3; ++corner) {
+      bool inserted;
+      auto local{local_vertices.insert(corners[corner], current[1], inserted)};
+      if (inserted) {
+        out.vertices.push_back(corners[corner]);
+        ++current[1];
+      }
+      packed |= local << (corner * 8);
+    }
+    out.triangles.push_back(packed);
+    ++current[3];
+  }
+  flush();
+}
+
+// Ritter's bounding sphere, starting from the most distant pair of axis
+// extremes and growing to include every point
+Vec4 bounding_sphere(std::span<const Vec3> points) {
+  std::array<size_t, 3> min_point{};
+  std::array<size_t, 3> max_point{};
+  for (size_t point{1}; point < points.size(); ++point) {
+    for (size_t axis{0}; axis < 3; ++axis) {
+      if (points[point][axis] < points[min_point[axis]][axis])
+        min_point[axis] = point;
+      if (points[point][axis] > points[max_point[axis]][axis])
+        max_point[axis] = point;
+    }
+  }
+
+  size_t widest{0};
+  float widest_distance{-1.0f};
+  for (size_t axis{0}; axis < 3; ++axis) {
+    auto distance{
+        length(points[max_point[axis]] - points[min_point[axis]])
+    };
+    if (distance > widest_distance) {
+      widest = axis;
+      widest_distance = distance;
+    }
+  }
+
+  const auto &a{points[min_point[widest]]};
+  const auto &b{points[max_point[widest]]};
+  Vec3 centre{
+      (a[0] + b[0]) * 0.5f,
+      (a[1] + b[1]) * 0.5f,
+      (a[2] + b[2]) * 0.5f,
+  };
+  auto radius{widest_distance * 0.5f};
+
+  for (const auto &point : points) {
+    auto distance{length(point - centre)};
+    if (distance <= radius)
+      continue;
+
+    // move the centre towards the point just enough to cover it
+    auto grown{(radius + distance) * 0.5f};
+    auto shift{(grown - radius) / distance};
+    for (size_t axis{0}; axis < 3; ++axis)
+      centre[axis] += (point[axis] - centre[axis]) * shift;
+    radius = grown;
+  }
+  return {centre[0], centre[1], centre[2], radius};
+}
+
+// averaged face normal and the sine of the largest angle any face deviates
+// from it, a zero axis with cutoff 1 marks a meshlet that cannot be culled
+Vec4 normal_cone(std::span<const Vec3> normals) {
+  Vec3 axis{};
+  for (const auto &normal : normals) {
+    for (size_t component{0}; component < 3; ++component)
+      axis[component] += normal[component];
+  }
+
+  auto axis_length{length(axis)};
+  if (axis_length == 0.0f)
+    return {0.0f, 0.0f, 0.0f, 1.0f};
+  for (auto &component : axis)
+    component /= axis_length;
+
+  auto min_dot{1.0f};
+  for (const auto &normal : normals)
+    min_dot = std::min(min_dot, dot(normal, axis));
+
+  // faces spread over a hemisphere or more always have one facing the camera
+  if (min_dot <= 0.0f)
+    return {0.0f, 0.0f, 0.0f, 1.0f};
+  return {axis[0], axis[1], axis[2], std::sqrt(1.0f - min_dot * min_dot)};
+}
+} // namespace
+
+void build_meshlets(
+    MeshData &mesh,
+    ThreadPool &pool,
+    const MeshletLimits &limits
+) {
+  if (!mesh.indices || mesh.primitive != Primitive::triangles) {
+    throw std::runtime_error(
+        "Only indexed triangle meshes can be split into meshlets"
+    );
+  }
+  if (limits.max_vertices < 3 || limits.max_vertices > 256 ||
+      limits.max_triangles == 0)
+    throw std::runtime_error("Invalid meshlet limits");
+
+  auto indices{decode_indices(*mesh.indices, mesh.index_count)};
+  auto positions{read_positions(mesh)};
+  auto triangle_count{indices.size() / 3};
+
+  // partition independent chunks, then stitch them together
+  auto chunk_count{(triangle_count + chunk_triangles - 1) / chunk_triangles};
+  std::vector<Meshlets> chunks(chunk_count);
+  parallel_for(pool, chunk_count, [&](size_t chunk_idx) {
+    auto first{chunk_idx * chunk_triangles};
+    auto count{std::min(chunk_triangles, triangle_count - first)};
+    partition(
+        std::span{indices}.subspan(first * 3, count * 3),
+        limits,
+        chunks[chunk_idx]
+    );
+  });
+
+  auto meshlets{std::make_shared<Meshlets>()};
+  for (const auto &chunk : chunks) {
+    auto vertex_base{static_cast<uint32_t>(meshlets->vertices.size())};
+    auto triangle_base{static_cast<uint32_t>(meshlets->triangles.size())};
+    for (auto range : chunk.ranges) {
+      range[0] += vertex_base;
+      range[2] += triangle_base;
+      meshlets->ranges.push_back(range);
+    }
+    meshlets->vertices.insert(
+        meshlets->vertices.end(),
+        chunk.vertices.begin(),
+        chunk.vertices.end()
+    );
+    meshlets->triangles.insert(
+        meshlets->triangles.end(),
+        chunk.triangles.begin(),
+        chunk.triangles.end()
+    );
+  }
+  chunks.clear();
+
+  auto meshlet_count{meshlets->ranges.size()};
+  meshlets->spheres.resize(meshlet_count);
+  meshlets->cones.resize(meshlet_count);
+
+  auto batch_count{(meshlet_count + bounds_batch - 1) / bounds_batch};
+  parallel_for(pool, batch_count, [&](size_t batch_idx) {
+    std::vector<Vec3> points;
+    std::vector<Vec3> normals;
+
+    auto end{std::min(meshlet_count, (batch_idx + 1) * bounds_batch)};
+    for (auto meshlet{batch_idx * bounds_batch}; meshlet < end; ++meshlet) {
+      auto [vertex_offset, vertex_count, triangle_offset, triangle_count]{
+          meshlets->ranges[meshlet]
+      };
+      auto vertices{
+          std::span{meshlets->vertices}.subspan(vertex_offset, vertex_count)
+      };
+
+      points.clear();
+      for (auto vertex : vertices)
+        points.push_back(positions[vertex]);
+      meshlets->spheres[meshlet] = bounding_sphere(points);
+
+      normals.clear();
+      for (uint32_t triangle{0}; triangle < triangle_count; ++triangle) {
+        auto packed{meshlets->triangles[triangle_offset + triangle]};
+        const auto &a{points[packed & 0xff]};
+        const auto &b{points[(packed >> 8) & 0xff]};
+        const auto &c{points[(packed >> 16) & 0xff]};
+
+        // degenerate triangles face nowhere and do not widen the cone
+        auto normal{cross(b - a, c - a)};
+        auto normal_length{length(normal)};
+        if (normal_length == 0.0f)
+          continue;
+        for (auto &component : normal)
+          component /= normal_length;
+        normals.push_back(normal);
+      }
+      meshlets->cones[meshlet] = normal_cone(normals);
+    }
+  });
+
+  mesh.meshlets = MeshletData{
+      .count = meshlet_count,
+      .ranges = std::as_bytes(std::span{meshlets->ranges}),
+      .spheres = std::as_bytes(std::span{meshlets->spheres}),
+      .cones = std::as_bytes(std::span{meshlets->cones}),
+      .vertices = std::as_bytes(std::span{meshlets->vertices}),
+      .triangles = std::as_bytes(std::span{meshlets->triangles}),
+  };
+  mesh.storage.push_back(std::move(meshlets));
+}
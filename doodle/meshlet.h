@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+#include "loader.h"
+#include "mesh.h"
+
+struct MeshletLimits {
+  // at most 256, meshlet vertex indices are stored in 8 bits
+  size_t max_vertices{64};
+  size_t max_triangles{124};
+};
+
+// Splits an indexed triangle mesh into meshlets and stores them in
+// mesh.meshlets, computing bounding spheres and normal cones on `pool`
+// Triangles are grouped in index order, so meshlets follow the locality
+// optimize_mesh establishes; run it first. Positions are read through
+// decode_attrib, so quantized meshes get bounds for the quantized positions.
+void build_meshlets(
+    MeshData &mesh,
+    ThreadPool &pool,
+    const MeshletLimits &limits = {}
+);
@@ -0,0 +1,420 @@
+#include "obj.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "file.h"
+
+namespace fs = std::filesystem;
+using std::string_view;
+
+namespace {
+struct Counts {
+  size_t positions{0};
+  size_t texcoords{0};
+  size_t normals{0};
+  size_t triangles{0};
+};
+
+// zero-based element indices of a face corner, -1 when absent
+struct Corner {
+  int32_t position;
+  int32_t texcoord;
+  int32_t normal;
+
+  bool operator==(const Corner &) const = default;
+};
+
+struct Range {
+  size_t begin;
+  size_t end;
+};
+
+std::vector<Range> split_lines(string_view text, size_t chunk_size) {
+  std::vector<Range> chunks;
+  size_t begin{0};
+  while (begin < text.size()) {
+    auto end{std::min(begin + chunk_size, text.size())};
+    if (end < text.size()) {
+      auto newline{text.find('\n', end)};
+      end = newline == string_view::npos ? text.size() : newline + 1;
+    }
+    chunks.push_back({begin, end});
+    begin = end;
+  }
+  return chunks;
+}
+
+template <typename Fn>
+void for_each_line(string_view text, Fn &&fn) {
+  while (!text.empty()) {
+    auto newline{text.find('\n')};
+    auto line{text.substr(0, newline)};
+    text.remove_prefix(
+        newline == string_view::npos ? text.size() : newline + 1
+    );
+
+    if (line.ends_with('\r'))
+      line.remove_suffix(1);
+    // comments run to the end of the line, also after elements
+    line = line.substr(0, line.find('#'));
+    fn(line);
+  }
+}
+
+string_view next_token(string_view &line) {
+  auto start{line.find_first_not_of(" \t")};
+  if (start == string_view::npos) {
+    line = {};
+    return {};
+  }
+  line.remove_prefix(start);
+
+  auto token{line.substr(0, line.find_first_of(" \t"))};
+  line.remove_prefix(token.size());
+  return token;
+}
+
+float parse_float(string_view token) {
+  float value{0.0f};
+  if (token.empty())
+    return value;
+
+  auto token_end{token.data() + token.size()};
+  auto [end, error]{std::from_chars(token.data(), token_end, value)};
+  if (error != std::errc{} || end != token_end)
+    throw ObjError(std::format("invalid number '{}'", token));
+  return value;
+}
+
+// resolves a one-based or negative relative OBJ index, `seen` is the number
+// of elements defined before the current line
+int32_t resolve_index(string_view token, size_t seen, size_t total) {
+  if (token.empty())
+    return -1;
+
+  int64_t raw;
+  auto token_end{token.data() + token.size()};
+  auto [end, error]{std::from_chars(token.data(), token_end, raw)};
+  if (error != std::errc{} || end != token_end || raw == 0)
+    throw ObjError(std::format("invalid index '{}'", token));
+
+  auto resolved{raw > 0 ? raw - 1 : static_cast<int64_t>(seen) + raw};
+  if (resolved < 0 || resolved >= static_cast<int64_t>(total))
+    throw ObjError(std::format("index '{}' out of range", token));
+  return static_cast<int32_t>(resolved);
+}
+
+Counts count_chunk(string_view text) {
+  Counts counts;
+  for_each_line(text, [&](string_view line) {
+    auto keyword{next_token(line)};
+    if (keyword == "v") {
+      ++counts.positions;
+    } else if (keyword == "vt") {
+      ++counts.texcoords;
+    } else if (keyword == "vn") {
+      ++counts.normals;
+    } else if (keyword == "f") {
+      size_t corners{0};
+      while (!next_token(line).empty())
+        ++corners;
+      if (corners >= 3)
+        counts.triangles += corners - 2;
+    }
+  });
+  return counts;
+}
+
+struct Elements {
+  std::vector<std::array<float, 3>> positions;
+  std::vector<std::array<float, 2>> texcoords;
+  std::vector<std::array<float, 3>> normals;
+};
+
+// decodes a chunk into the element arrays, starting at the offsets given by
+// the element counts of all preceding chunks, and appends the corners of its
+// triangles to `corners`
+void parse_chunk(
+    string_view text,
+    Counts base,
+    Elements &elements,
+    std::vector<Corner> &corners
+) {
+  auto seen{base};
+
+  for_each_line(text, [&](string_view line) {
+    auto keyword{next_token(line)};
+    if (keyword == "v") {
+      auto &position{elements.positions[seen.positions++]};
+      for (auto &component : position)
+        component = parse_float(next_token(line));
+    } else if (keyword == "vt") {
+      auto &texcoord{elements.texcoords[seen.texcoords++]};
+      for (auto &component : texcoord)
+        component = parse_float(next_token(line));
+    } else if (keyword == "vn") {
+      auto &normal{elements.normals[seen.normals++]};
+      for (auto &component : normal)
+        component = parse_float(next_token(line));
+    } else if (keyword == "f") {
+      auto parse_corner = [&](string_view token) {
+        auto first_slash{token.find('/')};
+        auto position_token{token.substr(0, first_slash)};
+        string_view texcoord_token, normal_token;
+        if (first_slash != string_view::npos) {
+          auto rest{token.substr(first_slash + 1)};
+          auto second_slash{rest.find('/')};
+          texcoord_token = rest.substr(0, second_slash);
+          if (second_slash != string_view::npos)
+            normal_token = rest.substr(second_slash + 1);
+        }
+
+        // the other indices are optional, the position is not
+        if (position_token.empty())
+          throw ObjError(std::format("corner '{}' has no position", token));
+
+        return Corner{
+            .position = resolve_index(
+                position_token,
+                seen.positions,
+                elements.positions.size()
+            ),
+            .texcoord = resolve_index(
+                texcoord_token,
+                seen.texcoords,
+                elements.texcoords.size()
+            ),
+            .normal = resolve_index(
+                normal_token,
+                seen.normals,
+                elements.normals.size()
+            ),
+        };
+      };
+
+      // triangulate polygons as a fan around the first corner
+      Corner first, previous;
+      size_t corner_count{0};
+      for (auto token{next_token(line)}; !token.empty();
+           token = next_token(line)) {
+        auto corner{parse_corner(token)};
+        if (corner_count == 0) {
+          first = corner;
+        } else if (corner_count >= 2) {
+          corners.insert(corners.end(), {first, previous, corner});
+        }
+        previous = corner;
+        ++corner_count;
+      }
+    }
+  });
+}
+
+// Open addressing table mapping corner tuples to vertex indices
+class CornerTable {
+  static constexpr uint32_t empty{UINT32_MAX};
+
+  std::vector<uint32_t> slots;
+  std::vector<Corner> &unique;
+
+  static size_t hash(const Corner &corner) {
+    auto h{static_cast<uint64_t>(static_cast<uint32_t>(corner.position)) *
+               0x9e3779b97f4a7c15ull ^
+           static_cast<uint64_t>(static_cast<uint32_t>(corner.texcoord)) *
+               0xc2b2ae3d27d4eb4full ^
+           static_cast<uint64_t>(static_cast<uint32_t>(corner.normal)) *
+               0x165667b19e3779f9ull};
+    return static_cast<size_t>(h ^ (h >> 29));
+  }
+
+  void grow() {
+    std::vector<uint32_t> old(slots.size() * 2, empty);
+    std::swap(old, slots);
+    for (auto vertex : old) {
+      if (vertex != empty)
+        slots[probe(unique[vertex])] = vertex;
+    }
+  }
+
+  size_t probe(const Corner &corner) const {
+    auto mask{slots.size() - 1};
+    auto slot{hash(corner) & mask};
+    while (slots[slot] != empty && unique[slots[slot]] != corner)
+      slot = (slot + 1) & mask;
+    return slot;
+  }
+
+public:
+  CornerTable(size_t expected, std::vector<Corner> &unique)
+      : slots(std::bit_ceil(std::max<size_t>(expected * 2, 16)), empty),
+        unique(unique) {}
+
+  uint32_t insert(const Corner &corner) {
+    auto slot{probe(corner)};
+    if (slots[slot] != empty)
+      return slots[slot];
+
+    auto vertex{static_cast<uint32_t>(unique.size())};
+    unique.push_back(corner);
+    slots[slot] = vertex;
+
+    // keep the load factor below one half
+    if (unique.size() * 2 > slots.size())
+      grow();
+    return vertex;
+  }
+};
+} // namespace
+
+MeshData import_obj(const fs::path &path, ThreadPool &pool, size_t chunk_size) {
+  MappedFile file{path, FileAccess::sequential};
+  auto text{file.text()};
+  auto chunks{split_lines(text, chunk_size)};
+
+  // first pass, count elements per chunk to find where each chunk writes
+  std::vector<Counts> chunk_counts(chunks.size());
+  parallel_for(pool, chunks.size(), [&](size_t chunk_idx) {
+    auto [begin, end]{chunks[chunk_idx]};
+    chunk_counts[chunk_idx] = count_chunk(text.substr(begin, end - begin));
+    file.release(begin, end - begin);
+  });
+
+  std::vector<Counts> chunk_bases(chunks.size());
+  Counts total;
+  for (size_t chunk_idx{0}; chunk_idx < chunks.size(); ++chunk_idx) {
+    chunk_bases[chunk_idx] = total;
+    total.positions += chunk_counts[chunk_idx].positions;
+    total.texcoords += chunk_counts[chunk_idx].texcoords;
+    total.normals += chunk_counts[chunk_idx].normals;
+    total.triangles += chunk_counts[chunk_idx].triangles;
+  }
+  if (total.triangles == 0)
+    throw ObjError("file contains no faces");
+  if (total.positions > INT32_MAX || total.texcoords > INT32_MAX ||
+      total.normals > INT32_MAX)
+    throw ObjError("too many elements");
+
+  // second pass, decode every chunk straight into its slice of the element
+  // arrays, which faces index at random, and deduplicate the corners of one
+  // wave of chunks into indexed vertices before decoding the next, so only a
+  // wave's corners are held at a time
+  Elements elements{
+      .positions = std::vector<std::array<float, 3>>(total.positions),
+      .texcoords = std::vector<std::array<float, 2>>(total.texcoords),
+      .normals = std::vector<std::array<float, 3>>(total.normals),
+  };
+  std::vector<Corner> unique;
+  unique.reserve(total.positions);
+  std::vector<uint32_t> indices;
+  indices.reserve(total.triangles * 3);
+  CornerTable table{total.positions, unique};
+
+  auto wave_size{pool.size() + 1};
+  std::vector<std::vector<Corner>> wave_corners(wave_size);
+  for (size_t wave{0}; wave < chunks.size(); wave += wave_size) {
+    auto count{std::min(wave_size, chunks.size() - wave)};
+    parallel_for(pool, count, [&](size_t wave_idx) {
+      auto chunk_idx{wave + wave_idx};
+      auto [begin, end]{chunks[chunk_idx]};
+      auto &corners{wave_corners[wave_idx]};
+      corners.clear();
+      corners.reserve(chunk_counts[chunk_idx].triangles * 3);
+      parse_chunk(
+          text.substr(begin, end - begin),
+          chunk_bases[chunk_idx],
+          elements,
+          corners
+      );
+      file.release(begin, end - begin);
+    });
+
+    // in chunk order, so vertices are numbered as they first appear
+    for (size_t wave_idx{0}; wave_idx < count; ++wave_idx) {
+      for (const auto &corner : wave_corners[wave_idx])
+        indices.push_back(table.insert(corner));
+    }
+  }
+  wave_corners = {};
+
+  // interleave position, then optional texcoord and normal
+  auto has_texcoords{total.texcoords > 0};
+  auto has_normals{total.normals > 0};
+
+  VertexFormat format{.stride = 0};
+  auto add_attrib = [&](AttribLocation location, size_t size) {
+    format.attribs.push_back(VertexAttrib{
+        .props =
+            VertexAttribProps{
+                .location = location,
+                .type = AttribType::f32,
+                .size = size,
+            },
+        .offset = format.stride,
+        .normalized = false,
+    });
+    format.stride += size * sizeof(float);
+  };
+  add_attrib(AttribLocation::position, 3);
+  if (has_texcoords)
+    add_attrib(AttribLocation::texcoord, 2);
+  if (has_normals)
+    add_attrib(AttribLocation::normal, 3);
+
+  auto floats_per_vertex{format.stride / sizeof(float)};
+  auto vertices{std::make_shared<std::vector<float>>(
+      unique.size() * floats_per_vertex
+  )};
+  parallel_for(pool, pool.size() + 1, [&](size_t part) {
+    auto parts{pool.size() + 1};
+    auto begin{unique.size() * part / parts};
+    auto end{unique.size() * (part + 1) / parts};
+
+    for (auto vertex{begin}; vertex < end; ++vertex) {
+      const auto &corner{unique[vertex]};
+      auto out{vertices->data() + vertex * floats_per_vertex};
+
+      out = std::ranges::copy(elements.positions[corner.position], out).out;
+      if (has_texcoords) {
+        std::array<float, 2> texcoord{};
+        if (corner.texcoord >= 0)
+          texcoord = elements.texcoords[corner.texcoord];
+        out = std::ranges::copy(texcoord, out).out;
+      }
+      if (has_normals) {
+        std::array<float, 3> normal{};
+        if (corner.normal >= 0)
+          normal = elements.normals[corner.normal];
+        std::ranges::copy(normal, out);
+      }
+    }
+  });
+
+  auto index_type{narrowest_index_type(unique.size())};
+  auto index_bytes{std::make_shared<std::vector<std::byte>>(
+      encode_indices(indices, index_type)
+  )};
+
+  MeshData mesh{
+      .primitive = Primitive::triangles,
+      .vertex_count = unique.size(),
+      .index_count = indices.size(),
+  };
+  mesh.streams.push_back(VertexStreamData{
+      .format = std::move(format),
+      .bytes = std::as_bytes(std::span(*vertices)),
+  });
+  mesh.indices = IndexStreamData{
+      .type = index_type,
+      .bytes = *index_bytes,
+  };
+  mesh.storage.push_back(std::move(vertices));
+  mesh.storage.push_back(std::move(index_bytes));
+  return mesh;
+}
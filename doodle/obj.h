@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <string>
+
+#include "loader.h"
+#include "mesh.h"
+
+class ObjError : public std::runtime_error {
+public:
+  explicit ObjError(const std::string &reason)
+      : std::runtime_error(std::format("Failed to import OBJ: {}", reason)) {}
+};
+
+// bytes of source text each parse job works on
+constexpr size_t obj_chunk_size{16 << 20};
+
+// Imports a Wavefront OBJ file as a single indexed triangle mesh
+// The file is split into chunks at line boundaries and parsed on `pool` in
+// two passes, one counting elements and one decoding them into place. Source
+// pages are released as chunks are consumed, so resident text stays bounded
+// by the chunks in flight. Identical position/texcoord/normal tuples share a
+// vertex and indices use the narrowest IndexType.
+MeshData import_obj(
+    const std::filesystem::path &path,
+    ThreadPool &pool,
+    size_t chunk_size = obj_chunk_size
+);
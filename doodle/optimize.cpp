@@ -0,0 +1,498 @@
+#include "optimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+// FIFO cache simulation, a vertex is cached while fewer than `size`
+// insertions happened since its own
+class FifoCache {
+  std::vector<uint32_t> stamps;
+  uint32_t time;
+  uint32_t size;
+
+public:
+  FifoCache(size_t vertex_count, size_t size)
+      : stamps(vertex_count, 0), time(static_cast<uint32_t>(size) + 1),
+        size(static_cast<uint32_t>(size)) {}
+
+  // returns true on a miss
+  bool access(uint32_t vertex) {
+    if (time - stamps[vertex] <= size)
+      return false;
+
+    stamps[vertex] = time++;
+    return true;
+  }
+
+  void clear() { time += size + 1; }
+};
+
+using Vec3 = std::array<float, 3>;
+
+Vec3 operator-(const Vec3 &a, const Vec3 &b) {
+  return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+Vec3 cross(const Vec3 &a, const Vec3 &b) {
+  return {
+      a[1] * b[2] - a[2] * b[1],
+      a[2] * b[0] - a[0] * b[2],
+      a[0] * b[1] - a[1] * b[0],
+  };
+}
+
+float dot(const Vec3 &a, const Vec3 &b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+} // namespace
+
+VertexCacheStats analyze_vertex_cache(
+    std::span<const uint32_t> indices,
+    size_t vertex_count,
+    size_t cache_size
+) {
+  FifoCache cache{vertex_count, cache_size};
+  std::vector<bool> referenced(vertex_count, false);
+
+  size_t misses{0};
+  size_t unique{0};
+  for (auto index : indices) {
+    misses += cache.access(index);
+    if (!referenced[index]) {
+      referenced[index] = true;
+      ++unique;
+    }
+  }
+
+  auto triangle_count{indices.size() / 3};
+  return VertexCacheStats{
+      .acmr = triangle_count ? float(misses) / float(triangle_count) : 0.0f,
+      .atvr = unique ? float(misses) / float(unique) : 0.0f,
+  };
+}
+
+std::vector<uint32_t> optimize_vertex_cache(
+    std::span<uint32_t> indices,
+    size_t vertex_count,
+    size_t cache_size
+) {
+  auto triangle_count{indices.size() / 3};
+
+  // triangles adjacent to every vertex, in compressed row form
+  std::vector<uint32_t> live(vertex_count, 0);
+  for (auto index : indices)
+    ++live[index];
+
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  std::inclusive_scan(live.begin(), live.end(), offsets.begin() + 1);
+
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t triangle{0}; triangle < triangle_count; ++triangle) {
+      for (size_t corner{0}; corner < 3; ++corner)
+        adjacency[fill[indices[triangle * 3 + corner]]++] = triangle;
+    }
+  }
+
+  std::vector<uint32_t> cache_time(vertex_count, 0);
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  std::vector<uint32_t> clusters;
+  output.reserve(indices.size());
+
+  auto time{static_cast<uint32_t>(cache_size) + 1};
+  size_t cursor{0};
+  auto next_live_vertex = [&]() -> int64_t {
+    while (cursor < vertex_count && live[cursor] == 0)
+      ++cursor;
+    return cursor < vertex_count ? static_cast<int64_t>(cursor) : -1;
+  };
+
+  auto fanning{next_live_vertex()};
+  if (fanning >= 0)
+    clusters.push_back(0);
+
+  while (fanning >= 0) {
+    // emit every remaining triangle around the fanning vertex
+    candidates.clear();
+    for (auto adjacency_idx{offsets[fanning]};
+         adjacency_idx < offsets[fanning + 1];
+         ++adjacency_idx) {
+      auto triangle{adjacency[adjacency_idx]};
+      if (emitted[triangle])
+        continue;
+
+      for (size_t corner{0}; corner < 3; ++corner) {
+        auto vertex{indices[triangle * 3 + corner]};
+        output.push_back(vertex);
+        dead_end.push_back(vertex);
+        candidates.push_back(vertex);
+        --live[vertex];
+
+        if (time - cache_time[vertex] > cache_size)
+          cache_time[vertex] = time++;
+      }
+      emitted[triangle] = true;
+    }
+
+    // prefer the candidate that stays cached longest after its own fan
+    int64_t next{-1};
+    int64_t best_priority{-1};
+    for (auto vertex : candidates) {
+      if (live[vertex] == 0)
+        continue;
+
+      int64_t priority{0};
+      if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size)
+        priority = time - cache_time[vertex];
+      if (priority > best_priority) {
+        best_priority = priority;
+        next = vertex;
+      }
+    }
+
+    if (next < 0) {
+      // dead end, fall back to recently emitted vertices first
+      while (!dead_end.empty()) {
+        auto vertex{dead_end.back()};
+        dead_end.pop_back();
+        if (live[vertex] > 0) {
+          next = vertex;
+          break;
+        }
+      }
+    }
+
+    if (next < 0) {
+      // nothing recent is left, the cache is effectively flushed
+      next = next_live_vertex();
+      if (next >= 0)
+        clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+    }
+
+    fanning = next;
+  }
+
+  std::ranges::copy(output, indices.begin());
+  return clusters;
+}
+
+void optimize_overdraw(
+    std::span<uint32_t> indices,
+    std::span<const std::array<float, 3>> positions,
+    std::span<const uint32_t> clusters,
+    float threshold,
+    size_t cache_size
+) {
+  auto triangle_count{static_cast<uint32_t>(indices.size() / 3)};
+  if (triangle_count == 0)
+    return;
+
+  // split clusters further wherever their running cache efficiency is
+  // already within the threshold of the whole cluster
+  FifoCache cache{positions.size(), cache_size};
+  auto triangle_misses = [&](uint32_t triangle) {
+    uint32_t misses{0};
+    for (size_t corner{0}; corner < 3; ++corner)
+      misses += cache.access(indices[triangle * 3 + corner]);
+    return misses;
+  };
+
+  std::vector<uint32_t> boundaries;
+  for (size_t cluster_idx{0}; cluster_idx < clusters.size(); ++cluster_idx) {
+    auto start{clusters[cluster_idx]};
+    auto end{
+        cluster_idx + 1 < clusters.size() ? clusters[cluster_idx + 1]
+                                          : triangle_count
+    };
+
+    cache.clear();
+    uint32_t cluster_misses{0};
+    for (auto triangle{start}; triangle < end; ++triangle)
+      cluster_misses += triangle_misses(triangle);
+    auto cluster_acmr{float(cluster_misses) / float(end - start)};
+
+    cache.clear();
+    boundaries.push_back(start);
+    auto begin{start};
+    uint32_t misses{0};
+    for (auto triangle{start}; triangle + 1 < end; ++triangle) {
+      misses += triangle_misses(triangle);
+      auto acmr{float(misses) / float(triangle + 1 - begin)};
+      if (acmr <= cluster_acmr * threshold) {
+        boundaries.push_back(triangle + 1);
+        begin = triangle + 1;
+        misses = 0;
+        cache.clear();
+      }
+    }
+  }
+  boundaries.push_back(triangle_count);
+
+  // area weighted centroid of the mesh
+  Vec3 mesh_centroid{};
+  float mesh_area{0.0f};
+  auto triangle_geometry = [&](uint32_t triangle, Vec3 &centroid) {
+    const auto &a{positions[indices[triangle * 3 + 0]]};
+    const auto &b{positions[indices[triangle * 3 + 1]]};
+    const auto &c{positions[indices[triangle * 3 + 2]]};
+    for (size_t axis{0}; axis < 3; ++axis)
+      centroid[axis] = (a[axis] + b[axis] + c[axis]) / 3.0f;
+    // twice the area, along the face normal
+    return cross(b - a, c - a);
+  };
+  for (uint32_t triangle{0}; triangle < triangle_count; ++triangle) {
+    Vec3 centroid;
+    auto normal{triangle_geometry(triangle, centroid)};
+    auto area{std::sqrt(dot(normal, normal))};
+    for (size_t axis{0}; axis < 3; ++axis)
+      mesh_centroid[axis] += centroid[axis] * area;
+    mesh_area += area;
+  }
+  if (mesh_area > 0.0f) {
+    for (auto &axis : mesh_centroid)
+      axis /= mesh_area;
+  }
+
+  // sort key, how far a cluster faces away from the mesh centre
+  auto cluster_count{boundaries.size() - 1};
+  std::vector<float> sort_keys(cluster_count);
+  for (size_t cluster_idx{0}; cluster_idx < cluster_count; ++cluster_idx) {
+    Vec3 centroid{};
+    Vec3 normal{};
+    float area{0.0f};
+    for (auto triangle{boundaries[cluster_idx]};
+         triangle < boundaries[cluster_idx + 1];
+         ++triangle) {
+      Vec3 triangle_centroid;
+      auto triangle_normal{triangle_geometry(triangle, triangle_centroid)};
+      auto triangle_area{std::sqrt(dot(triangle_normal, triangle_normal))};
+      for (size_t axis{0}; axis < 3; ++axis) {
+        centroid[axis] += triangle_centroid[axis] * triangle_area;
+        normal[axis] += triangle_normal[axis];
+      }
+      area += triangle_area;
+    }
+    if (area > 0.0f) {
+      for (auto &axis : centroid)
+        axis /= area;
+    }
+
+    auto normal_length{std::sqrt(dot(normal, normal))};
+    sort_keys[cluster_idx] =
+        normal_length > 0.0f
+            ? dot(centroid - mesh_centroid, normal) / normal_length
+            : 0.0f;
+  }
+
+  std::vector<size_t> order(cluster_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, [&](size_t a, size_t b) {
+    return sort_keys[a] > sort_keys[b];
+  });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (auto cluster_idx : order) {
+    output.insert(
+        output.end(),
+        indices.begin() + boundaries[cluster_idx] * 3,
+        indices.begin() + boundaries[cluster_idx + 1] * 3
+    );
+  }
+  std::ranges::copy(output, indices.begin());
+}
+
+size_t optimize_vertex_fetch(
+    std::span<uint32_t> indices,
+    size_t vertex_count,
+    std::vector<uint32_t> &remap
+) {
+  remap.assign(vertex_count, UINT32_MAX);
+
+  uint32_t next{0};
+  for (auto &index : indices) {
+    if (remap[index] == UINT32_MAX)
+      remap[index] = next++;
+    index = remap[index];
+  }
+  return next;
+}
+
+void remap_vertex_streams(
+    MeshData &mesh,
+    std::span<const uint32_t> remap,
+    size_t vertex_count,
+    std::vector<std::shared_ptr<const void>> &storage
+) {
+  for (auto &stream : mesh.streams) {
+    auto stride{stream.format.stride};
+    auto bytes{std::make_shared<std::vector<std::byte>>(vertex_count * stride)};
+
+    for (size_t vertex{0}; vertex < mesh.vertex_count; ++vertex) {
+      if (remap[vertex] == UINT32_MAX)
+        continue;
+
+      // the last vertex of a stream may end before a full stride
+      auto offset{vertex * stride};
+      auto size{std::min(stride, stream.bytes.size() - offset)};
+      std::memcpy(
+          bytes->data() + remap[vertex] * stride,
+          stream.bytes.data() + offset,
+          size
+      );
+    }
+
+    stream.bytes = *bytes;
+    storage.push_back(std::move(bytes));
+  }
+}
+
+OptimizeReport optimize_mesh(MeshData &mesh) {
+  if (!mesh.indices || mesh.primitive != Primitive::triangles)
+    throw std::runtime_error("Only indexed triangle meshes can be optimized");
+
+  auto indices{decode_indices(*mesh.indices, mesh.index_count)};
+  auto positions{read_positions(mesh)};
+
+  OptimizeReport report{
+      .before = analyze_vertex_cache(indices, mesh.vertex_count),
+  };
+
+  auto clusters{optimize_vertex_cache(indices, mesh.vertex_count)};
+  optimize_overdraw(indices, positions, clusters);
+
+  std::vector<uint32_t> remap;
+  auto vertex_count{optimize_vertex_fetch(indices, mesh.vertex_count, remap)};
+  report.after = analyze_vertex_cache(indices, vertex_count);
+
+  // rebuild every stream in the new vertex order
+  std::vector<std::shared_ptr<const void>> storage;
+  remap_vertex_streams(mesh, remap, vertex_count, storage);
+
+  auto index_type{narrowest_index_type(vertex_count)};
+  auto index_bytes{std::make_shared<std::vector<std::byte>>(
+      encode_indices(indices, index_type)
+  )};
+  mesh.indices = IndexStreamData{.type = index_type, .bytes = *index_bytes};
+  storage.push_back(std::move(index_bytes));
+
+  mesh.vertex_count = vertex_count;
+  // meshlets refer to the old vertex order and storage
+  mesh.meshlets.reset();
+  mesh.storage = std::move(storage);
+  return report;
+}
+
+std::vector<uint32_t>
+stripify(std::span<const uint32_t> indices, size_t vertex_count) {
+  auto triangle_count{static_cast<uint32_t>(indices.size() / 3)};
+
+  // triangles around each vertex, in list order
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (auto index : indices)
+    ++offsets[index + 1];
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  std::vector<uint32_t> adjacency(indices.size());
+  auto fill{offsets};
+  for (uint32_t triangle{0}; triangle < triangle_count; ++triangle) {
+    for (size_t corner{0}; corner < 3; ++corner)
+      adjacency[fill[indices[triangle * 3 + corner]]++] = triangle;
+  }
+
+  // earliest unused triangle holding the directed edge a -> b
+  std::vector<bool> used(triangle_count, false);
+  auto find_next = [&](uint32_t a, uint32_t b, uint32_t &third) {
+    for (auto idx{offsets[a]}; idx < offsets[a + 1]; ++idx) {
+      auto triangle{adjacency[idx]};
+      if (used[triangle])
+        continue;
+
+      auto corners{indices.subspan(triangle * 3, 3)};
+      for (size_t corner{0}; corner < 3; ++corner) {
+        if (corners[corner] == a && corners[(corner + 1) % 3] == b) {
+          third = corners[(corner + 2) % 3];
+          return triangle;
+        }
+      }
+    }
+    return UINT32_MAX;
+  };
+
+  std::vector<uint32_t> strips;
+  for (uint32_t first{0}; first < triangle_count; ++first) {
+    if (used[first])
+      continue;
+    used[first] = true;
+
+    // rotate the first triangle so its last edge leads into a neighbour
+    auto corners{indices.subspan(first * 3, 3)};
+    size_t rotation{0};
+    for (size_t candidate{0}; candidate < 3; ++candidate) {
+      uint32_t third;
+      auto next{find_next(
+          corners[(candidate + 2) % 3],
+          corners[(candidate + 1) % 3],
+          third
+      )};
+      if (next != UINT32_MAX) {
+        rotation = candidate;
+        break;
+      }
+    }
+
+    if (!strips.empty())
+      strips.push_back(UINT32_MAX);
+    for (size_t corner{0}; corner < 3; ++corner)
+      strips.push_back(corners[(rotation + corner) % 3]);
+
+    // triangle n of a strip is (v[n], v[n + 1], v[n + 2]) when n is even
+    // and (v[n + 1], v[n], v[n + 2]) when it is odd
+    for (size_t strip_triangle{1};; ++strip_triangle) {
+      auto p{strips[strips.size() - 2]};
+      auto q{strips[strips.size() - 1]};
+      uint32_t third;
+      auto next{
+          strip_triangle % 2 == 0 ? find_next(p, q, third)
+                                  : find_next(q, p, third)
+      };
+      if (next == UINT32_MAX)
+        break;
+
+      used[next] = true;
+      strips.push_back(third);
+    }
+  }
+  return strips;
+}
+
+bool stripify_mesh(MeshData &mesh) {
+  if (!mesh.indices || mesh.primitive != Primitive::triangles)
+    throw std::runtime_error("Only indexed triangle lists can be stripified");
+
+  auto indices{decode_indices(*mesh.indices, mesh.index_count)};
+  auto strips{stripify(indices, mesh.vertex_count)};
+
+  auto strip_type{narrowest_index_type(mesh.vertex_count, true)};
+  if (strips.size() * index_size(strip_type) >=
+      indices.size() * index_size(mesh.indices->type))
+    return false;
+
+  auto bytes{std::make_shared<std::vector<std::byte>>(
+      encode_indices(strips, strip_type)
+  )};
+  mesh.primitive = Primitive::triangle_strip;
+  mesh.indices = IndexStreamData{.type = strip_type, .bytes = *bytes};
+  mesh.index_count = strips.size();
+  mesh.storage.push_back(std::move(bytes));
+  return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "mesh.h"
+
+// post-transform cache size assumed when optimizing and measuring
+constexpr size_t vertex_cache_size{16};
+
+struct VertexCacheStats {
+  // average cache miss ratio, transformed vertices per triangle (0.5 - 3.0)
+  float acmr;
+  // average transform to vertex ratio, transformed vertices per vertex
+  // referenced (1.0 is optimal)
+  float atvr;
+};
+
+// Simulates a FIFO post-transform cache over a triangle list
+VertexCacheStats analyze_vertex_cache(
+    std::span<const uint32_t> indices,
+    size_t vertex_count,
+    size_t cache_size = vertex_cache_size
+);
+
+// Reorders triangles for post-transform cache locality (Tipsify)
+// Returns the offsets of the first triangle of each cluster, clusters are
+// the runs between cache flushes and are the units optimize_overdraw moves.
+std::vector<uint32_t> optimize_vertex_cache(
+    std::span<uint32_t> indices,
+    size_t vertex_count,
+    size_t cache_size = vertex_cache_size
+);
+
+// Reorders clusters so outward facing geometry far from the mesh centre is
+// drawn first, splitting clusters where that costs at most `threshold` times
+// their cache efficiency
+void optimize_overdraw(
+    std::span<uint32_t> indices,
+    std::span<const std::array<float, 3>> positions,
+    std::span<const uint32_t> clusters,
+    float threshold = 1.05f,
+    size_t cache_size = vertex_cache_size
+);
+
+// Renumbers vertices in order of first use and drops unreferenced ones
+// Rewrites `indices` in place and returns the new vertex count, `remap`
+// receives the new index of every old vertex (UINT32_MAX when dropped).
+size_t optimize_vertex_fetch(
+    std::span<uint32_t> indices,
+    size_t vertex_count,
+    std::vector<uint32_t> &remap
+);
+
+// Rebuilds every vertex stream so vertex v moves to remap[v], dropping those
+// mapped to UINT32_MAX; the new streams are kept alive by `storage`, while
+// vertex_count, indices and storage of the mesh are left to the caller.
+void remap_vertex_streams(
+    MeshData &mesh,
+    std::span<const uint32_t> remap,
+    size_t vertex_count,
+    std::vector<std::shared_ptr<const void>> &storage
+);
+
+struct OptimizeReport {
+  VertexCacheStats before;
+  VertexCacheStats after;
+};
+
+// Runs the cache, overdraw and fetch passes over an indexed triangle mesh
+// and replaces its streams with reordered copies
+OptimizeReport optimize_mesh(MeshData &mesh);
+
+// Converts a triangle list into strips separated by UINT32_MAX, which
+// encode_indices turns into the restart index of the target type
+// Strips are started in list order and extended with the earliest adjacent
+// triangle, so the cache locality of the list is mostly kept.
+std::vector<uint32_t>
+stripify(std::span<const uint32_t> indices, size_t vertex_count);
+
+// Replaces the triangle list of an indexed mesh with strips when those take
+// fewer bytes, returns whether it did
+bool stripify_mesh(MeshData &mesh);
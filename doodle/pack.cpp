@@ -0,0 +1,235 @@
+#include "pack.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+
+static size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// copies a trivially copyable record out of the file, records are not
+// guaranteed to be aligned within the mapping
+template <typename T>
+static T read_record(std::span<const std::byte> bytes, size_t offset) {
+  if (offset > bytes.size() || sizeof(T) > bytes.size() - offset)
+    throw PackFormatError("truncated table of contents");
+
+  T record;
+  std::memcpy(&record, bytes.data() + offset, sizeof(T));
+  return record;
+}
+
+static bool
+in_bounds(std::span<const std::byte> bytes, const pack::Range &range) {
+  return range.offset <= bytes.size() &&
+         range.size <= bytes.size() - range.offset;
+}
+
+static size_t bucket_of(uint64_t hash, uint32_t bucket_bits) {
+  return bucket_bits == 0 ? 0 : static_cast<size_t>(hash >> (64 - bucket_bits));
+}
+
+Pack::Pack(const std::filesystem::path &path)
+    // assets are read by name in no particular order
+    : file(std::make_shared<const MappedFile>(path, FileAccess::random)) {
+  auto bytes{file->bytes()};
+
+  header = read_record<pack::Header>(bytes, 0);
+  if (header.magic != pack::magic)
+    throw PackFormatError("bad magic");
+  if (header.version != pack::version) {
+    throw PackFormatError(std::format(
+        "unsupported version {}, expected {}",
+        header.version,
+        pack::version
+    ));
+  }
+  if (header.bucket_bits > 32)
+    throw PackFormatError("too many buckets");
+
+  // entries and blobs are checked as lookups reach them
+  auto bucket_count{(uint64_t{1} << header.bucket_bits) + 1};
+  if (!in_bounds(bytes, header.entries) || !in_bounds(bytes, header.buckets) ||
+      !in_bounds(bytes, header.names) ||
+      header.entries.size !=
+          uint64_t{header.entry_count} * sizeof(pack::Entry) ||
+      header.buckets.size != bucket_count * sizeof(uint32_t))
+    throw PackFormatError("table of contents out of bounds");
+
+  // the table is consulted on every lookup, keep it resident
+  file->populate(header.entries.offset, header.entries.size);
+  file->populate(header.buckets.offset, header.buckets.size);
+  file->populate(header.names.offset, header.names.size);
+}
+
+pack::Entry Pack::entry(size_t entry_idx) const {
+  return read_record<pack::Entry>(
+      file->bytes(),
+      header.entries.offset + entry_idx * sizeof(pack::Entry)
+  );
+}
+
+std::optional<Asset> Pack::find(std::string_view name) const {
+  auto bytes{file->bytes()};
+  auto hash{fnv1a(name)};
+
+  auto bucket{bucket_of(hash, header.bucket_bits)};
+  auto bucket_offset{header.buckets.offset + bucket * sizeof(uint32_t)};
+  auto first{read_record<uint32_t>(bytes, bucket_offset)};
+  auto last{read_record<uint32_t>(bytes, bucket_offset + sizeof(uint32_t))};
+  if (first > last || last > header.entry_count)
+    throw PackFormatError("corrupt bucket table");
+
+  for (auto entry_idx{first}; entry_idx < last; ++entry_idx) {
+    auto candidate{entry(entry_idx)};
+    if (candidate.hash != hash)
+      continue;
+
+    pack::Range name_range{
+        .offset = header.names.offset + candidate.name_offset,
+        .size = candidate.name_size,
+    };
+    if (candidate.name_offset > header.names.size ||
+        candidate.name_size > header.names.size - candidate.name_offset)
+      throw PackFormatError("entry name out of bounds");
+
+    std::string_view entry_name{
+        reinterpret_cast<const char *>(bytes.data() + name_range.offset),
+        name_range.size
+    };
+    if (entry_name != name)
+      continue;
+
+    if (!in_bounds(bytes, candidate.data))
+      throw PackFormatError(std::format("blob of {} out of bounds", name));
+    return Asset{file, candidate.data.offset, candidate.data.size};
+  }
+  return std::nullopt;
+}
+
+void write_pack(std::ostream &out, std::span<const PackInput> inputs) {
+  if (inputs.size() > UINT32_MAX)
+    throw PackFormatError("too many assets");
+
+  std::vector<uint64_t> hashes(inputs.size());
+  for (size_t input_idx{0}; input_idx < inputs.size(); ++input_idx)
+    hashes[input_idx] = fnv1a(inputs[input_idx].name);
+
+  // table order, by hash and then name so duplicates end up adjacent
+  std::vector<size_t> order(inputs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::sort(order, [&](size_t a, size_t b) {
+    if (hashes[a] != hashes[b])
+      return hashes[a] < hashes[b];
+    return inputs[a].name < inputs[b].name;
+  });
+  for (size_t idx{1}; idx < order.size(); ++idx) {
+    if (inputs[order[idx - 1]].name == inputs[order[idx]].name) {
+      throw PackFormatError(
+          std::format("duplicate asset {}", inputs[order[idx]].name)
+      );
+    }
+  }
+
+  // one bucket per entry rounded up to a power of two, about one candidate
+  // per lookup
+  auto entry_count{static_cast<uint32_t>(inputs.size())};
+  auto bucket_bits{
+      entry_count <= 1
+          ? 0u
+          : static_cast<uint32_t>(std::bit_width(entry_count - 1))
+  };
+  auto bucket_count{(size_t{1} << bucket_bits) + 1};
+
+  std::string names;
+  for (const auto &input : inputs)
+    names += input.name;
+  if (names.size() > UINT32_MAX)
+    throw PackFormatError("asset names too long");
+
+  pack::Header header{
+      .magic = pack::magic,
+      .version = pack::version,
+      .entry_count = entry_count,
+      .bucket_bits = bucket_bits,
+      .entries =
+          {
+              .offset = sizeof(pack::Header),
+              .size = entry_count * sizeof(pack::Entry),
+          },
+      .buckets = {},
+      .names = {},
+  };
+  header.buckets = {
+      .offset = header.entries.offset + header.entries.size,
+      .size = bucket_count * sizeof(uint32_t),
+  };
+  header.names = {
+      .offset = header.buckets.offset + header.buckets.size,
+      .size = names.size(),
+  };
+
+  // blobs follow in input order, names in the same order
+  std::vector<pack::Entry> by_input(inputs.size());
+  auto offset{
+      align_up(header.names.offset + header.names.size, pack::alignment)
+  };
+  uint32_t name_offset{0};
+  for (size_t input_idx{0}; input_idx < inputs.size(); ++input_idx) {
+    const auto &input{inputs[input_idx]};
+    by_input[input_idx] = pack::Entry{
+        .hash = hashes[input_idx],
+        .data = {.offset = offset, .size = input.bytes.size()},
+        .name_offset = name_offset,
+        .name_size = static_cast<uint32_t>(input.name.size()),
+    };
+    name_offset += static_cast<uint32_t>(input.name.size());
+    offset = align_up(offset + input.bytes.size(), pack::alignment);
+  }
+
+  std::vector<pack::Entry> entries;
+  entries.reserve(inputs.size());
+  for (auto input_idx : order)
+    entries.push_back(by_input[input_idx]);
+
+  // buckets[bucket] is the first entry whose bucket is at least `bucket`
+  std::vector<uint32_t> buckets(bucket_count, entry_count);
+  for (auto entry_idx{entry_count}; entry_idx-- > 0;)
+    buckets[bucket_of(entries[entry_idx].hash, bucket_bits)] = entry_idx;
+  for (auto bucket{bucket_count - 1}; bucket-- > 0;)
+    buckets[bucket] = std::min(buckets[bucket], buckets[bucket + 1]);
+
+  // emit records and blobs in the order they were laid out
+  size_t written{0};
+  auto write = [&](const void *data, size_t size) {
+    out.write(
+        static_cast<const char *>(data),
+        static_cast<std::streamsize>(size)
+    );
+    written += size;
+  };
+  auto pad_to = [&](size_t target) {
+    static constexpr std::array<char, pack::alignment> zeros{};
+    while (written < target)
+      write(zeros.data(), std::min(target - written, zeros.size()));
+  };
+
+  write(&header, sizeof(header));
+  write(entries.data(), entries.size() * sizeof(pack::Entry));
+  write(buckets.data(), buckets.size() * sizeof(uint32_t));
+  write(names.data(), names.size());
+
+  for (size_t input_idx{0}; input_idx < inputs.size(); ++input_idx) {
+    pad_to(by_input[input_idx].data.offset);
+    write(inputs[input_idx].bytes.data(), inputs[input_idx].bytes.size());
+  }
+
+  if (!out)
+    throw std::runtime_error("Failed to write asset pack");
+}
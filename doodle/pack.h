@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "file.h"
+
+// Single file asset archive (.dpak)
+//
+// Layout:
+//   Header
+//   Entry[header.entry_count], sorted by name hash
+//   uint32_t buckets[(1 << header.bucket_bits) + 1]
+//   entry names
+//   asset blobs, each aligned to pack::alignment
+//
+// The top bucket_bits of a name's hash select a bucket, and entries
+// [buckets[bucket], buckets[bucket + 1]) are the only candidates for the name,
+// so a lookup touches a bucket pair and an expected single entry. Blobs hold
+// the asset files byte-for-byte. All values are stored little-endian.
+namespace pack {
+constexpr std::array<char, 4> magic{'D', 'P', 'A', 'K'};
+constexpr uint32_t version{1};
+// keeps .dmesh payloads inside blobs at their own alignment
+constexpr size_t alignment{16};
+
+// byte range relative to the start of the file
+struct Range {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct Entry {
+  // fnv1a of the name
+  uint64_t hash;
+  Range data;
+  // range of the name within the names section
+  uint32_t name_offset;
+  uint32_t name_size;
+};
+
+struct Header {
+  std::array<char, 4> magic;
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t bucket_bits;
+  Range entries;
+  Range buckets;
+  Range names;
+};
+
+static_assert(sizeof(Entry) == 32);
+static_assert(sizeof(Header) == 64);
+} // namespace pack
+
+class PackFormatError : public std::runtime_error {
+public:
+  explicit PackFormatError(const std::string &reason)
+      : std::runtime_error(std::format("Invalid asset pack: {}", reason)) {}
+};
+
+// Read-only view of a mapped asset pack, safe to share between threads
+class Pack {
+  std::shared_ptr<const MappedFile> file;
+  pack::Header header;
+
+  pack::Entry entry(size_t entry_idx) const;
+
+public:
+  explicit Pack(const std::filesystem::path &path);
+
+  // returns a view of the named asset, or nothing when the pack lacks it
+  std::optional<Asset> find(std::string_view name) const;
+
+  size_t size() const { return header.entry_count; }
+};
+
+struct PackInput {
+  std::string name;
+  std::span<const std::byte> bytes;
+};
+
+// Serializes assets into the .dpak layout, blobs are written in input order
+// Throws PackFormatError when two inputs share a name.
+void write_pack(std::ostream &out, std::span<const PackInput> inputs);
@@ -0,0 +1,167 @@
+#include "preprocess.h"
+
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <utility>
+
+#include "hash.h"
+
+// position of an #include directive within its file
+struct Include {
+  std::string name;
+  // start of the directive's line
+  size_t offset;
+  // start of the line after it, and that line's number
+  size_t resume;
+  size_t resume_line;
+};
+
+// texts are copies, so saving a loose file in place cannot fault sources
+// still being compiled from it
+struct ShaderPreprocessor::File {
+  std::string text;
+  std::vector<Include> includes;
+};
+
+static std::string normalize(std::string_view name) {
+  return std::filesystem::path{name}.lexically_normal().string();
+}
+
+static std::string_view trim_front(std::string_view text) {
+  auto begin{text.find_first_not_of(" \t")};
+  return begin == std::string_view::npos ? std::string_view{}
+                                         : text.substr(begin);
+}
+
+static std::vector<Include>
+parse_includes(std::string_view text, std::string_view file_name) {
+  std::vector<Include> includes;
+  size_t line_number{1};
+  for (size_t line_start{0}; line_start < text.size(); ++line_number) {
+    auto line_end{text.find('\n', line_start)};
+    auto next{line_end == std::string_view::npos ? text.size() : line_end + 1};
+    auto line{text.substr(line_start, next - line_start)};
+
+    auto directive{trim_front(line)};
+    if (directive.starts_with('#')) {
+      directive = trim_front(directive.substr(1));
+      if (directive.starts_with("include")) {
+        auto argument{trim_front(directive.substr(7))};
+        auto close{argument.empty() ? '\0' : argument[0] == '<' ? '>' : '"'};
+        auto end{argument.find(close, 1)};
+        if ((argument.empty() || (argument[0] != '"' && argument[0] != '<')) ||
+            end == std::string_view::npos || end == 1) {
+          throw PreprocessError(
+              std::format("{}:{}: malformed #include", file_name, line_number)
+          );
+        }
+
+        includes.push_back(Include{
+            .name = normalize(argument.substr(1, end - 1)),
+            .offset = line_start,
+            .resume = next,
+            .resume_line = line_number + 1,
+        });
+      }
+    }
+    line_start = next;
+  }
+  return includes;
+}
+
+ShaderPreprocessor::ShaderPreprocessor(const AssetLibrary &assets)
+    : assets(assets) {}
+
+std::shared_ptr<const ShaderPreprocessor::File>
+ShaderPreprocessor::file(const std::string &name) {
+  uint64_t generation;
+  {
+    std::lock_guard lock{mutex};
+    if (auto cached{files.find(name)}; cached != files.end())
+      return cached->second;
+    generation = generations[name];
+  }
+
+  // parsed outside the lock, two threads may race to parse a file and the
+  // first one to finish wins
+  auto text{assets.read_text(name)};
+  auto includes{parse_includes(text, name)};
+  auto parsed{
+      std::make_shared<const File>(std::move(text), std::move(includes))
+  };
+
+  // a file invalidated meanwhile may have been read before the change, it is
+  // used by this source only and read again by the rebuild that follows
+  std::lock_guard lock{mutex};
+  if (generations[name] != generation)
+    return parsed;
+  return files.try_emplace(name, std::move(parsed)).first->second;
+}
+
+void ShaderPreprocessor::append(
+    const std::string &name,
+    PreprocessedSource &source
+) {
+  if (std::ranges::find(source.files, name) != source.files.end())
+    return;
+
+  auto parsed{file(name)};
+  auto string_number{source.files.size()};
+  source.files.push_back(name);
+  source.storage.push_back(parsed);
+
+  // directives are generated text, they live in a deque so earlier chunks
+  // stay valid as more are added
+  auto directives{std::make_shared<std::deque<std::string>>()};
+  source.storage.push_back(directives);
+  auto line_directive = [&](size_t line) {
+    source.chunks.push_back(directives->emplace_back(
+        std::format("#line {} {}\n", line, string_number)
+    ));
+  };
+
+  // the root keeps its first line for #version
+  if (string_number > 0)
+    line_directive(1);
+
+  std::string_view text{parsed->text};
+  size_t position{0};
+  for (const auto &include : parsed->includes) {
+    if (include.offset > position)
+      source.chunks.push_back(text.substr(position, include.offset - position));
+    append(include.name, source);
+    line_directive(include.resume_line);
+    position = include.resume;
+  }
+  if (position < text.size())
+    source.chunks.push_back(text.substr(position));
+}
+
+PreprocessedSource ShaderPreprocessor::preprocess(std::string_view name) {
+  auto root{normalize(name)};
+  PreprocessedSource source;
+  append(root, source);
+
+  source.hash = fnv1a_basis;
+  for (auto chunk : source.chunks)
+    source.hash = fnv1a(chunk, source.hash);
+
+  std::lock_guard lock{mutex};
+  for (const auto &file : source.files)
+    dependents[file].insert(root);
+  return source;
+}
+
+std::vector<std::string> ShaderPreprocessor::invalidate(std::string_view name) {
+  auto key{normalize(name)};
+
+  // edges are kept, a file that is no longer included only costs a reload
+  std::lock_guard lock{mutex};
+  files.erase(key);
+  ++generations[key];
+  auto roots{dependents.find(key)};
+  if (roots == dependents.end())
+    return {};
+  return {roots->second.begin(), roots->second.end()};
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "assets.h"
+
+class PreprocessError : public std::runtime_error {
+public:
+  explicit PreprocessError(const std::string &reason)
+      : std::runtime_error(
+            std::format("Failed to preprocess shader: {}", reason)
+        ) {}
+};
+
+// GLSL source with its #include directives resolved, as the chunks handed to
+// glShaderSource
+// Chunks point into the cached file texts and generated #line directives,
+// which `storage` keeps alive.
+struct PreprocessedSource {
+  std::vector<std::string_view> chunks;
+  // every file the source was assembled from, the index of a file is its
+  // source string number in compiler messages, the root is 0
+  std::vector<std::string> files;
+  // fnv1a over the resolved text
+  uint64_t hash{0};
+  std::vector<std::shared_ptr<const void>> storage;
+};
+
+// Resolves `#include "name"` directives in shader sources
+// Included names are asset names. Every file is parsed once and shared by all
+// sources including it until it is invalidated, and is included at most once
+// per source, so shared headers need no guards and cycles end by themselves.
+// Safe to use from any thread.
+class ShaderPreprocessor {
+  struct File;
+
+  const AssetLibrary &assets;
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<const File>> files;
+  // times a file was invalidated, a parse started before the last one is
+  // not cached
+  std::unordered_map<std::string, uint64_t> generations;
+  // file to the root sources that included it, directly or not, since it was
+  // last invalidated
+  std::unordered_map<std::string, std::unordered_set<std::string>> dependents;
+
+  std::shared_ptr<const File> file(const std::string &name);
+  void append(const std::string &name, PreprocessedSource &source);
+
+public:
+  explicit ShaderPreprocessor(const AssetLibrary &assets);
+
+  // Throws PreprocessError for malformed directives and AssetNotFoundError
+  // for missing files
+  PreprocessedSource preprocess(std::string_view name);
+
+  // Drops the cached contents of a changed file and returns the root sources
+  // that have to be preprocessed again, the file itself when it is one
+  std::vector<std::string> invalidate(std::string_view name);
+};
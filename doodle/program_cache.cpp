@@ -0,0 +1,121 @@
+#include "program_cache.h"
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "file.h"
+#include "hash.h"
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::string_view gl_string(GLenum name) {
+  auto text{reinterpret_cast<const char *>(glGetString(name))};
+  return text ? text : "";
+}
+
+ProgramCache::ProgramCache(fs::path directory)
+    : directory(std::move(directory)) {
+  GLint format_count{0};
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+  supported = format_count > 0;
+
+  // separators keep "ab" + "c" apart from "a" + "bc"
+  for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    driver_hash = fnv1a(gl_string(name), driver_hash);
+    driver_hash = fnv1a("\n", driver_hash);
+  }
+}
+
+uint64_t ProgramCache::key(uint64_t source_hash) const {
+  return fnv1a(std::as_bytes(std::span{&source_hash, 1}), driver_hash);
+}
+
+fs::path ProgramCache::entry_path(uint64_t key) const {
+  return directory / std::format("{:016x}.dprog", key);
+}
+
+std::optional<gl::Program> ProgramCache::load(uint64_t source_hash) const {
+  if (!supported)
+    return std::nullopt;
+
+  auto entry_key{key(source_hash)};
+  auto path{entry_path(entry_key)};
+  std::error_code error;
+  if (!fs::is_regular_file(path, error))
+    return std::nullopt;
+
+  // an unreadable or damaged entry is a miss, the program gets compiled
+  MappedFile file;
+  try {
+    file = MappedFile{path};
+  } catch (const std::runtime_error &) {
+    return std::nullopt;
+  }
+
+  auto bytes{file.bytes()};
+  program_cache::Header header;
+  if (bytes.size() < sizeof(header))
+    return std::nullopt;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != program_cache::magic ||
+      header.version != program_cache::version || header.key != entry_key ||
+      header.size != bytes.size() - sizeof(header))
+    return std::nullopt;
+
+  gl::Program program;
+  if (!program.load_binary(header.format, bytes.subspan(sizeof(header))))
+    return std::nullopt;
+  return program;
+}
+
+void
+ProgramCache::store(uint64_t source_hash, const gl::Program &program) const {
+  if (!supported)
+    return;
+
+  GLenum format{0};
+  auto binary{program.binary(format)};
+  if (binary.empty() || binary.size() > UINT32_MAX)
+    return;
+
+  auto entry_key{key(source_hash)};
+  program_cache::Header header{
+      .magic = program_cache::magic,
+      .version = program_cache::version,
+      .key = entry_key,
+      .format = format,
+      .size = static_cast<uint32_t>(binary.size()),
+  };
+
+  std::error_code error;
+  fs::create_directories(directory, error);
+  if (error)
+    return;
+
+  // written to a temporary sibling first, so a concurrently starting process
+  // never maps a partial entry
+  auto path{entry_path(entry_key)};
+  auto temporary{path};
+  temporary += std::format(".{}.tmp", getpid());
+  {
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(
+        reinterpret_cast<const char *>(binary.data()),
+        static_cast<std::streamsize>(binary.size())
+    );
+    if (!out) {
+      out.close();
+      fs::remove(temporary, error);
+      return;
+    }
+  }
+  fs::rename(temporary, path, error);
+}
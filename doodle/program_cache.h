@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+#include "gl.h"
+
+// On-disk cache of linked program binaries (.dprog)
+//
+// Layout:
+//   Header
+//   driver program binary
+//
+// Binaries only load on the driver that produced them, so entries are keyed
+// by the source hash combined with the GL vendor, renderer and version
+// strings, and a driver update simply misses. Drivers may still reject a
+// binary they produced, callers then compile from source and store again.
+namespace program_cache {
+constexpr std::array<char, 4> magic{'D', 'P', 'R', 'G'};
+constexpr uint32_t version{1};
+
+struct Header {
+  std::array<char, 4> magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t size;
+};
+
+static_assert(sizeof(Header) == 24);
+} // namespace program_cache
+
+// Must be created and used on the GL thread
+class ProgramCache {
+  std::filesystem::path directory;
+  uint64_t driver_hash{0};
+  bool supported{false};
+
+  uint64_t key(uint64_t source_hash) const;
+  std::filesystem::path entry_path(uint64_t key) const;
+
+public:
+  explicit ProgramCache(std::filesystem::path directory);
+
+  // false when the driver offers no binary formats, loads then always miss
+  bool enabled() const { return supported; }
+
+  // returns a linked program, or nothing when there is no entry or the driver
+  // rejects it
+  std::optional<gl::Program> load(uint64_t source_hash) const;
+
+  // stores a program linked after retain_binary(), failures to write only
+  // cost a compile on the next start
+  void store(uint64_t source_hash, const gl::Program &program) const;
+};
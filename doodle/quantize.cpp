@@ -0,0 +1,199 @@
+#include "quantize.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+using Value = std::array<float, 4>;
+
+// GL fills components missing from the buffer with (0, 0, 0, 1), padding a
+// value to a wider format must not change what the shader reads
+constexpr Value missing_components{0.0f, 0.0f, 0.0f, 1.0f};
+
+struct DecodedAttrib {
+  VertexAttrib source;
+  std::vector<Value> values;
+};
+
+DecodedAttrib decode_values(
+    const VertexStreamData &stream,
+    const VertexAttrib &attrib,
+    size_t vertex_count
+) {
+  DecodedAttrib decoded{
+      .source = attrib,
+      .values = std::vector<Value>(vertex_count),
+  };
+  auto components{std::min<size_t>(attrib.props.size, 4)};
+  for (size_t vertex{0}; vertex < vertex_count; ++vertex) {
+    auto in{
+        stream.bytes.data() + vertex * stream.format.stride + attrib.offset
+    };
+    auto value{decode_attrib(in, attrib)};
+    for (auto component{components}; component < 4; ++component)
+      value[component] = missing_components[component];
+    decoded.values[vertex] = value;
+  }
+  return decoded;
+}
+
+// largest error of any stored component after encoding as `candidate`,
+// NaN when a value does not survive at all
+float round_trip_error(
+    const DecodedAttrib &attrib,
+    const VertexAttrib &candidate
+) {
+  auto components{std::min<size_t>(attrib.source.props.size, 4)};
+  // wide enough for four doubles
+  std::array<std::byte, 32> scratch;
+
+  float error{0.0f};
+  for (const auto &value : attrib.values) {
+    encode_attrib(scratch.data(), candidate, value);
+    auto decoded{decode_attrib(scratch.data(), candidate)};
+    for (size_t component{0}; component < components; ++component) {
+      auto difference{std::abs(decoded[component] - value[component])};
+      if (!(difference <= error))
+        error = difference;
+    }
+  }
+  return error;
+}
+
+// formats worth trying for an attribute, smallest first
+std::vector<VertexAttribProps>
+candidate_formats(const VertexAttribProps &props) {
+  auto location{props.location};
+  auto size{props.size};
+
+  std::vector<VertexAttribProps> candidates;
+  switch (location) {
+  case AttribLocation::position:
+    // positions stay floating point, the shader applies no dequantization
+    // transform that snorm or unorm positions would need
+    candidates = {{location, AttribType::f16, size}};
+    break;
+  case AttribLocation::normal:
+    if (size <= 4)
+      candidates.push_back({location, AttribType::i10_10_10_2, 4});
+    candidates.push_back({location, AttribType::i8, size});
+    candidates.push_back({location, AttribType::i16, size});
+    candidates.push_back({location, AttribType::f16, size});
+    break;
+  case AttribLocation::texcoord:
+    candidates.push_back({location, AttribType::u8, size});
+    candidates.push_back({location, AttribType::u16, size});
+    candidates.push_back({location, AttribType::f16, size});
+    break;
+  }
+
+  // only formats that actually save space are of interest
+  std::erase_if(candidates, [&](const VertexAttribProps &candidate) {
+    return attrib_size(candidate) >= attrib_size(props);
+  });
+  return candidates;
+}
+
+float error_bound(
+    const DecodedAttrib &attrib,
+    const QuantizeSettings &settings
+) {
+  switch (attrib.source.props.location) {
+  case AttribLocation::position: {
+    if (attrib.values.empty())
+      return 0.0f;
+
+    // relative to the bounds, so the bound means the same for any scale
+    auto components{std::min<size_t>(attrib.source.props.size, 3)};
+    float extent{0.0f};
+    for (size_t component{0}; component < components; ++component) {
+      auto [min, max]{std::ranges::minmax(
+          attrib.values,
+          {},
+          [&](const Value &value) { return value[component]; }
+      )};
+      extent = std::max(extent, max[component] - min[component]);
+    }
+    return settings.position_error * extent;
+  }
+  case AttribLocation::normal:
+    return settings.normal_error;
+  case AttribLocation::texcoord:
+    return settings.texcoord_error;
+  }
+  return 0.0f;
+}
+
+VertexAttrib choose_format(
+    const DecodedAttrib &attrib,
+    const QuantizeSettings &settings
+) {
+  auto bound{error_bound(attrib, settings)};
+  for (const auto &props : candidate_formats(attrib.source.props)) {
+    // integer candidates are always normalized, half floats never are
+    VertexAttrib candidate{
+        .props = props,
+        .offset = 0,
+        .normalized = props.type != AttribType::f16,
+    };
+    if (round_trip_error(attrib, candidate) <= bound)
+      return candidate;
+  }
+
+  auto original{attrib.source};
+  original.offset = 0;
+  return original;
+}
+
+constexpr size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+QuantizeReport quantize_mesh(MeshData &mesh, const QuantizeSettings &settings) {
+  QuantizeReport report{.vertex_size_before = 0, .vertex_size_after = 0};
+
+  std::vector<DecodedAttrib> attribs;
+  for (const auto &stream : mesh.streams) {
+    report.vertex_size_before += stream.format.stride;
+    for (const auto &attrib : stream.format.attribs)
+      attribs.push_back(decode_values(stream, attrib, mesh.vertex_count));
+  }
+
+  std::ranges::sort(attribs, {}, [](const DecodedAttrib &attrib) {
+    return attrib.source.props.location;
+  });
+
+  // keep every attribute 4 byte aligned, as GL implementations prefer
+  VertexFormat format{.attribs = {}, .stride = 0};
+  for (const auto &attrib : attribs) {
+    auto chosen{choose_format(attrib, settings)};
+    chosen.offset = format.stride;
+    format.stride = align_up(chosen.offset + attrib_size(chosen.props), 4);
+    format.attribs.push_back(chosen);
+  }
+
+  auto bytes{std::make_shared<std::vector<std::byte>>(
+      mesh.vertex_count * format.stride
+  )};
+  for (size_t attrib_idx{0}; attrib_idx < attribs.size(); ++attrib_idx) {
+    const auto &attrib{format.attribs[attrib_idx]};
+    const auto &values{attribs[attrib_idx].values};
+    for (size_t vertex{0}; vertex < mesh.vertex_count; ++vertex) {
+      auto out{bytes->data() + vertex * format.stride + attrib.offset};
+      encode_attrib(out, attrib, values[vertex]);
+    }
+  }
+
+  // indices may still point into the existing storage, so extend it
+  mesh.streams = {
+      VertexStreamData{.format = std::move(format), .bytes = *bytes}
+  };
+  mesh.storage.push_back(std::move(bytes));
+
+  report.vertex_size_after = mesh.streams.front().format.stride;
+  return report;
+}
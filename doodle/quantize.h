@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+#include "mesh.h"
+
+struct QuantizeSettings {
+  // largest position error, relative to the largest extent of the bounds
+  float position_error{1e-4f};
+  // largest error of any normal component
+  float normal_error{0.005f};
+  // largest error of any texture coordinate component
+  float texcoord_error{1.0f / 4096};
+};
+
+struct QuantizeReport {
+  // bytes per vertex summed over every stream
+  size_t vertex_size_before;
+  size_t vertex_size_after;
+};
+
+// Stores every attribute in the smallest type that reproduces it within the
+// error bounds and repacks the streams into a single interleaved one
+// Candidates are measured by encoding and decoding every vertex, so the
+// bounds hold for the data rather than for a worst case estimate. Attributes
+// other than positions, normals and texture coordinates are copied as is.
+QuantizeReport
+quantize_mesh(MeshData &mesh, const QuantizeSettings &settings = {});
@@ -0,0 +1,291 @@
+#include "reflect.h"
+
+#include <algorithm>
+#include <array>
+
+// appends a resource name to the pool
+static LayoutName read_name(
+    GLuint program,
+    GLenum interface,
+    GLuint index,
+    GLint length,
+    std::string &names
+) {
+  LayoutName name{.offset = static_cast<uint32_t>(names.size()), .size = 0};
+  if (length <= 0)
+    return name;
+
+  // the reported length counts the terminator
+  names.resize(names.size() + length);
+  GLsizei written;
+  glGetProgramResourceName(
+      program,
+      interface,
+      index,
+      length,
+      &written,
+      names.data() + name.offset
+  );
+  names.resize(name.offset + written);
+  name.size = static_cast<uint32_t>(written);
+  return name;
+}
+
+static GLint resource_count(GLuint program, GLenum interface) {
+  GLint count{0};
+  glGetProgramInterfaceiv(program, interface, GL_ACTIVE_RESOURCES, &count);
+  return count;
+}
+
+static void read_inputs(GLuint program, ProgramLayout &layout) {
+  constexpr std::array<GLenum, 4> props{
+      GL_LOCATION,
+      GL_TYPE,
+      GL_ARRAY_SIZE,
+      GL_NAME_LENGTH
+  };
+
+  auto count{resource_count(program, GL_PROGRAM_INPUT)};
+  for (GLint input_idx{0}; input_idx < count; ++input_idx) {
+    std::array<GLint, props.size()> values;
+    glGetProgramResourceiv(
+        program,
+        GL_PROGRAM_INPUT,
+        input_idx,
+        props.size(),
+        props.data(),
+        values.size(),
+        nullptr,
+        values.data()
+    );
+
+    // built-ins such as gl_VertexID have no location
+    if (values[0] < 0)
+      continue;
+
+    layout.inputs.push_back(ShaderInput{
+        .location = values[0],
+        .type = static_cast<GLenum>(values[1]),
+        .array_size = values[2],
+        .name = read_name(
+            program,
+            GL_PROGRAM_INPUT,
+            input_idx,
+            values[3],
+            layout.names
+        ),
+    });
+  }
+
+  std::ranges::sort(layout.inputs, {}, &ShaderInput::location);
+}
+
+// reads every block of `block_interface`, whose variables are resources of
+// `variable_interface`
+static void read_blocks(
+    GLuint program,
+    GLenum block_interface,
+    GLenum variable_interface,
+    std::vector<ShaderBlock> &blocks,
+    ProgramLayout &layout
+) {
+  constexpr std::array<GLenum, 4> block_props{
+      GL_BUFFER_BINDING,
+      GL_BUFFER_DATA_SIZE,
+      GL_NUM_ACTIVE_VARIABLES,
+      GL_NAME_LENGTH
+  };
+  constexpr std::array<GLenum, 6> member_props{
+      GL_TYPE,
+      GL_OFFSET,
+      GL_ARRAY_SIZE,
+      GL_ARRAY_STRIDE,
+      GL_MATRIX_STRIDE,
+      GL_NAME_LENGTH
+  };
+
+  auto count{resource_count(program, block_interface)};
+  for (GLint block_idx{0}; block_idx < count; ++block_idx) {
+    std::array<GLint, block_props.size()> values;
+    glGetProgramResourceiv(
+        program,
+        block_interface,
+        block_idx,
+        block_props.size(),
+        block_props.data(),
+        values.size(),
+        nullptr,
+        values.data()
+    );
+
+    ShaderBlock block{
+        .binding = values[0],
+        .size = values[1],
+        .first_member = static_cast<uint32_t>(layout.members.size()),
+        .member_count = static_cast<uint32_t>(values[2]),
+        .name = read_name(
+            program,
+            block_interface,
+            block_idx,
+            values[3],
+            layout.names
+        ),
+    };
+
+    std::vector<GLint> variables(block.member_count);
+    constexpr GLenum active_variables{GL_ACTIVE_VARIABLES};
+    if (!variables.empty())
+      glGetProgramResourceiv(
+          program,
+          block_interface,
+          block_idx,
+          1,
+          &active_variables,
+          static_cast<GLsizei>(variables.size()),
+          nullptr,
+          variables.data()
+      );
+
+    for (auto variable : variables) {
+      std::array<GLint, member_props.size()> member;
+      glGetProgramResourceiv(
+          program,
+          variable_interface,
+          variable,
+          member_props.size(),
+          member_props.data(),
+          member.size(),
+          nullptr,
+          member.data()
+      );
+
+      layout.members.push_back(BlockMember{
+          .type = static_cast<GLenum>(member[0]),
+          .offset = member[1],
+          .array_size = member[2],
+          .array_stride = member[3],
+          .matrix_stride = member[4],
+          .name = read_name(
+              program,
+              variable_interface,
+              variable,
+              member[5],
+              layout.names
+          ),
+      });
+    }
+
+    std::ranges::sort(
+        layout.members.begin() + block.first_member,
+        layout.members.end(),
+        {},
+        &BlockMember::offset
+    );
+    blocks.push_back(block);
+  }
+}
+
+ProgramLayout reflect_program(GLuint program) {
+  ProgramLayout layout;
+  read_inputs(program, layout);
+  read_blocks(
+      program,
+      GL_UNIFORM_BLOCK,
+      GL_UNIFORM,
+      layout.uniform_blocks,
+      layout
+  );
+  read_blocks(
+      program,
+      GL_SHADER_STORAGE_BLOCK,
+      GL_BUFFER_VARIABLE,
+      layout.storage_blocks,
+      layout
+  );
+  return layout;
+}
+
+static std::optional<ShaderBlock> find_block(
+    const ProgramLayout &layout,
+    std::span<const ShaderBlock> blocks,
+    std::string_view block_name
+) {
+  auto block{std::ranges::find_if(blocks, [&](const ShaderBlock &block) {
+    return layout.name(block.name) == block_name;
+  })};
+  if (block == blocks.end())
+    return std::nullopt;
+  return *block;
+}
+
+std::optional<ShaderBlock>
+ProgramLayout::uniform_block(std::string_view block_name) const {
+  return find_block(*this, uniform_blocks, block_name);
+}
+
+std::optional<ShaderBlock>
+ProgramLayout::storage_block(std::string_view block_name) const {
+  return find_block(*this, storage_blocks, block_name);
+}
+
+std::optional<BlockMember> ProgramLayout::member(
+    const ShaderBlock &block,
+    std::string_view member_name
+) const {
+  auto block_span{block_members(block)};
+  auto member{std::ranges::find_if(block_span, [&](const BlockMember &member) {
+    return name(member.name) == member_name;
+  })};
+  if (member == block_span.end())
+    return std::nullopt;
+  return *member;
+}
+
+GLint input_locations(GLenum type) {
+  switch (type) {
+  case GL_FLOAT_MAT2:
+  case GL_FLOAT_MAT2x3:
+  case GL_FLOAT_MAT2x4:
+  case GL_DOUBLE_MAT2:
+  case GL_DOUBLE_MAT2x3:
+  case GL_DOUBLE_MAT2x4:
+    return 2;
+  case GL_FLOAT_MAT3:
+  case GL_FLOAT_MAT3x2:
+  case GL_FLOAT_MAT3x4:
+  case GL_DOUBLE_MAT3:
+  case GL_DOUBLE_MAT3x2:
+  case GL_DOUBLE_MAT3x4:
+    return 3;
+  case GL_FLOAT_MAT4:
+  case GL_FLOAT_MAT4x2:
+  case GL_FLOAT_MAT4x3:
+  case GL_DOUBLE_MAT4:
+  case GL_DOUBLE_MAT4x2:
+  case GL_DOUBLE_MAT4x3:
+    return 4;
+  default:
+    return 1;
+  }
+}
+
+bool is_float_input(GLenum type) {
+  switch (type) {
+  case GL_FLOAT:
+  case GL_FLOAT_VEC2:
+  case GL_FLOAT_VEC3:
+  case GL_FLOAT_VEC4:
+  case GL_FLOAT_MAT2:
+  case GL_FLOAT_MAT2x3:
+  case GL_FLOAT_MAT2x4:
+  case GL_FLOAT_MAT3:
+  case GL_FLOAT_MAT3x2:
+  case GL_FLOAT_MAT3x4:
+  case GL_FLOAT_MAT4:
+  case GL_FLOAT_MAT4x2:
+  case GL_FLOAT_MAT4x3:
+    return true;
+  default:
+    return false;
+  }
+}
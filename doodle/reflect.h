@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glad/gl.h>
+
+// range of a name within ProgramLayout::names
+struct LayoutName {
+  uint32_t offset{0};
+  uint32_t size{0};
+};
+
+// Active vertex shader input
+struct ShaderInput {
+  GLint location;
+  // GLSL type, e.g. GL_FLOAT_VEC3
+  GLenum type;
+  GLint array_size;
+  LayoutName name;
+};
+
+// Variable of a uniform or shader storage block, with the offsets and strides
+// the driver chose, which match std140/std430 for blocks declared with them
+struct BlockMember {
+  GLenum type;
+  GLint offset;
+  GLint array_size;
+  GLint array_stride;
+  GLint matrix_stride;
+  LayoutName name;
+};
+
+struct ShaderBlock {
+  GLint binding;
+  // minimum buffer size to back the block
+  GLint size;
+  // range within ProgramLayout::members
+  uint32_t first_member;
+  uint32_t member_count;
+  LayoutName name;
+};
+
+// Interface of a linked program, queried once after it is built
+// Tables are flat and names share one string, so the layout is a handful of
+// allocations however large the program. Inputs are sorted by location,
+// members of a block by offset.
+struct ProgramLayout {
+  std::vector<ShaderInput> inputs;
+  std::vector<ShaderBlock> uniform_blocks;
+  std::vector<ShaderBlock> storage_blocks;
+  std::vector<BlockMember> members;
+  std::string names;
+
+  std::string_view name(LayoutName name) const {
+    return std::string_view{names}.substr(name.offset, name.size);
+  }
+
+  std::optional<ShaderBlock> uniform_block(std::string_view block_name) const;
+  std::optional<ShaderBlock> storage_block(std::string_view block_name) const;
+
+  std::span<const BlockMember> block_members(const ShaderBlock &block) const {
+    return std::span{members}.subspan(block.first_member, block.member_count);
+  }
+
+  std::optional<BlockMember>
+  member(const ShaderBlock &block, std::string_view member_name) const;
+};
+
+// Queries inputs, uniform blocks and shader storage blocks of a linked program
+ProgramLayout reflect_program(GLuint program);
+
+// vertex attribute locations an input of GLSL type `type` occupies
+GLint input_locations(GLenum type);
+
+// whether the input reads floats, which every VertexAttrib type converts to
+bool is_float_input(GLenum type);
@@ -0,0 +1,557 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <initializer_list>
+#include <print>
+#include <unordered_map>
+#include <utility>
+
+#include <toml++/toml.hpp>
+
+// "<file>:<line>" of a node, for error messages
+static std::string where(std::string_view source_name, const toml::node &node) {
+  return std::format("{}:{}", source_name, node.source().begin.line);
+}
+
+static void check_keys(
+    const toml::table &entry,
+    std::initializer_list<std::string_view> allowed,
+    std::string_view source_name
+) {
+  // catches typos, which would otherwise silently fall back to defaults
+  for (auto &&[key, value] : entry) {
+    if (std::ranges::find(allowed, key.str()) == allowed.end())
+      throw ManifestError(std::format(
+          "{}: unknown key '{}'",
+          where(source_name, value),
+          key.str()
+      ));
+  }
+}
+
+static std::optional<std::string> string_value(
+    const toml::table &entry,
+    std::string_view key,
+    std::string_view source_name
+) {
+  auto node{entry.get(key)};
+  if (!node)
+    return std::nullopt;
+  auto value{node->value<std::string>()};
+  if (!value)
+    throw ManifestError(
+        std::format("{}: '{}' must be a string", where(source_name, *node), key)
+    );
+  return value;
+}
+
+static std::string required_string(
+    const toml::table &entry,
+    std::string_view key,
+    std::string_view source_name
+) {
+  auto value{string_value(entry, key, source_name)};
+  if (!value)
+    throw ManifestError(
+        std::format("{}: missing '{}'", where(source_name, entry), key)
+    );
+  return std::move(*value);
+}
+
+static std::optional<std::vector<std::string>> string_array(
+    const toml::table &entry,
+    std::string_view key,
+    std::string_view source_name
+) {
+  auto node{entry.get(key)};
+  if (!node)
+    return std::nullopt;
+
+  auto array{node->as_array()};
+  if (!array)
+    throw ManifestError(
+        std::format("{}: '{}' must be an array", where(source_name, *node), key)
+    );
+  std::vector<std::string> values;
+  for (const auto &element : *array) {
+    auto value{element.value<std::string>()};
+    if (!value)
+      throw ManifestError(std::format(
+          "{}: '{}' must only hold strings",
+          where(source_name, element),
+          key
+      ));
+    values.push_back(std::move(*value));
+  }
+  return values;
+}
+
+// calls `parse(name, entry)` for every entry of the [`section`] table
+template <typename Parse>
+static void for_each_entry(
+    const toml::table &root,
+    std::string_view section,
+    std::string_view source_name,
+    Parse parse
+) {
+  auto node{root.get(section)};
+  if (!node)
+    return;
+  auto table{node->as_table()};
+  if (!table)
+    throw ManifestError(std::format(
+        "{}: '{}' must be a table",
+        where(source_name, *node),
+        section
+    ));
+
+  for (auto &&[key, value] : *table) {
+    auto entry{value.as_table()};
+    if (!entry)
+      throw ManifestError(std::format(
+          "{}: '{}.{}' must be a table",
+          where(source_name, value),
+          section,
+          key.str()
+      ));
+    parse(std::string{key.str()}, *entry);
+  }
+}
+
+// asset names as the preprocessor reports changes to them
+static std::string normalize(std::string_view name) {
+  return std::filesystem::path{name}.lexically_normal().string();
+}
+
+SceneManifest
+parse_manifest(std::string_view text, std::string_view source_name) {
+  toml::table root;
+  try {
+    root = toml::parse(text, source_name);
+  } catch (const toml::parse_error &error) {
+    throw ManifestError(std::format(
+        "{}:{}: {}",
+        source_name,
+        error.source().begin.line,
+        error.description()
+    ));
+  }
+  check_keys(root, {"shaders", "materials", "meshes"}, source_name);
+
+  SceneManifest manifest;
+  for_each_entry(
+      root,
+      "shaders",
+      source_name,
+      [&](std::string name, const toml::table &entry) {
+        check_keys(entry, {"vertex", "fragment", "attribs"}, source_name);
+        auto stages{shader_stage_files(name)};
+        if (auto vertex{string_value(entry, "vertex", source_name)})
+          stages.vertex = std::move(*vertex);
+        if (auto fragment{string_value(entry, "fragment", source_name)})
+          stages.fragment = std::move(*fragment);
+        stages.vertex = normalize(stages.vertex);
+        stages.fragment = normalize(stages.fragment);
+
+        manifest.shaders.push_back(ShaderEntry{
+            .name = std::move(name),
+            .stages = std::move(stages),
+            .attribs = string_array(entry, "attribs", source_name),
+        });
+      }
+  );
+
+  for_each_entry(
+      root,
+      "materials",
+      source_name,
+      [&](std::string name, const toml::table &entry) {
+        check_keys(entry, {"shader"}, source_name);
+        auto shader{required_string(entry, "shader", source_name)};
+        if (std::ranges::find(manifest.shaders, shader, &ShaderEntry::name) ==
+            manifest.shaders.end())
+          throw ManifestError(std::format(
+              "{}: material {} uses undeclared shader {}",
+              where(source_name, entry),
+              name,
+              shader
+          ));
+        manifest.materials.push_back({std::move(name), std::move(shader)});
+      }
+  );
+
+  for_each_entry(
+      root,
+      "meshes",
+      source_name,
+      [&](std::string name, const toml::table &entry) {
+        check_keys(entry, {"material"}, source_name);
+        auto material{required_string(entry, "material", source_name)};
+        auto declared{std::ranges::find(
+            manifest.materials,
+            material,
+            &MaterialEntry::name
+        )};
+        if (declared == manifest.materials.end())
+          throw ManifestError(std::format(
+              "{}: mesh {} uses undeclared material {}",
+              where(source_name, entry),
+              name,
+              material
+          ));
+        manifest.meshes.push_back({std::move(name), std::move(material)});
+      }
+  );
+
+  return manifest;
+}
+
+SceneManifest read_manifest(const AssetLibrary &assets, std::string_view name) {
+  auto asset{assets.open(name)};
+  return parse_manifest(asset.text(), name);
+}
+
+CriticalPath critical_path(
+    std::span<const LoadNode> nodes,
+    LoadClock::time_point start
+) {
+  CriticalPath path;
+  std::optional<size_t> last;
+  for (size_t node_idx{0}; node_idx < nodes.size(); ++node_idx) {
+    if (nodes[node_idx].complete &&
+        (!last || *nodes[node_idx].complete > *nodes[*last].complete))
+      last = node_idx;
+  }
+  if (!last)
+    return path;
+
+  path.length = *nodes[*last].complete - start;
+  for (auto node_idx{*last};;) {
+    path.nodes.push_back(node_idx);
+    const auto &node{nodes[node_idx]};
+
+    // a complete node has complete dependencies, the chain continues into
+    // the one completing last if the node was still waiting on it
+    auto waited{std::ranges::max_element(
+        node.dependencies,
+        {},
+        [&](size_t dependency) { return *nodes[dependency].complete; }
+    )};
+    if (waited == node.dependencies.end() ||
+        *nodes[*waited].complete <= *node.work_done)
+      break;
+    node_idx = *waited;
+  }
+  std::ranges::reverse(path.nodes);
+  return path;
+}
+
+// whether a node can never complete, because it or a dependency failed
+static bool blocked(std::span<const LoadNode> nodes, size_t node_idx) {
+  const auto &node{nodes[node_idx]};
+  return node.failed ||
+         std::ranges::any_of(node.dependencies, [&](size_t dependency) {
+           return blocked(nodes, dependency);
+         });
+}
+
+// Throws std::runtime_error when the program's vertex inputs differ from the
+// ones the manifest declares
+static void check_attribs(
+    const Shader &shader,
+    std::string_view label,
+    std::span<const std::string> attribs
+) {
+  const auto &layout{shader.layout};
+  for (const auto &input : layout.inputs) {
+    if (std::ranges::find(attribs, layout.name(input.name)) == attribs.end())
+      throw std::runtime_error(std::format(
+          "Vertex input {} of {} is not declared in the manifest",
+          layout.name(input.name),
+          label
+      ));
+  }
+  for (const auto &attrib : attribs) {
+    if (std::ranges::none_of(layout.inputs, [&](const ShaderInput &input) {
+          return layout.name(input.name) == attrib;
+        }))
+      throw std::runtime_error(std::format(
+          "Declared vertex input {} of {} is not active",
+          attrib,
+          label
+      ));
+  }
+}
+
+Scene::ShaderSlot::ShaderSlot(
+    const ShaderEntry &entry,
+    size_t node,
+    AssetLoader &loader,
+    ShaderPreprocessor &preprocessor,
+    const ProgramCache &cache
+)
+    : shader{},
+      reloader{shader, entry.stages, loader, preprocessor, cache},
+      attribs(entry.attribs),
+      node(node) {}
+
+Scene::Scene(
+    const SceneManifest &manifest,
+    const AssetLibrary &assets,
+    AssetLoader &loader,
+    MeshArena &mesh_arena,
+    ShaderPreprocessor &preprocessor,
+    const ProgramCache &program_cache,
+    const CookCache &import_cache
+)
+    : loader(loader), mesh_arena(mesh_arena), start(LoadClock::now()) {
+  // entries are added in dependency order, so are their nodes
+  std::unordered_map<std::string_view, size_t> shader_indices;
+  for (const auto &entry : manifest.shaders) {
+    shader_indices.emplace(entry.name, shader_slots.size());
+    auto &slot{shader_slots.emplace_back(
+        entry,
+        nodes.size(),
+        loader,
+        preprocessor,
+        program_cache
+    )};
+    nodes.push_back(LoadNode{.label = std::format("shader {}", entry.name)});
+    slot.reloader.request();
+  }
+
+  // the program is replaced once its build completes, so materials can
+  // reference their shader before it is ready
+  std::unordered_map<std::string_view, size_t> material_indices;
+  for (const auto &entry : manifest.materials) {
+    auto shader{shader_indices.find(entry.shader)};
+    if (shader == shader_indices.end())
+      throw ManifestError(std::format("undeclared shader {}", entry.shader));
+
+    material_indices.emplace(entry.name, material_slots.size());
+    material_slots.push_back(MaterialSlot{
+        .material = Material{shader_slots[shader->second].shader},
+        .shader = shader->second,
+        .node = nodes.size(),
+    });
+    // materials do no work of their own yet
+    nodes.push_back(LoadNode{
+        .label = std::format("material {}", entry.name),
+        .dependencies = {shader_slots[shader->second].node},
+        .work_done = start,
+    });
+  }
+
+  for (const auto &entry : manifest.meshes) {
+    auto material{material_indices.find(entry.material)};
+    if (material == material_indices.end())
+      throw ManifestError(
+          std::format("undeclared material {}", entry.material)
+      );
+
+    const auto &slot{material_slots[material->second]};
+    mesh_slots.push_back(MeshSlot{
+        .load = stream_mesh(
+            loader,
+            mesh_arena,
+            assets,
+            entry.name,
+            slot.material,
+            import_cache
+        ),
+        .stream = std::nullopt,
+        .refine = {},
+        .material = material->second,
+        .node = nodes.size(),
+        .inputs_match = std::nullopt,
+    });
+    nodes.push_back(LoadNode{
+        .label = std::format("mesh {}", entry.name),
+        .dependencies = {slot.node},
+    });
+  }
+}
+
+void Scene::request_if_affected(std::span<const std::string> sources) {
+  for (auto &slot : shader_slots)
+    slot.reloader.request_if_affected(sources);
+}
+
+void Scene::watch_sources(FileWatcher &watcher) const {
+  for (const auto &slot : shader_slots) {
+    for (const auto &file : slot.reloader.source_files())
+      watcher.watch(file);
+  }
+}
+
+void Scene::update_nodes() {
+  // dependencies precede their dependents, one pass settles every node
+  for (auto &node : nodes) {
+    if (node.complete || !node.work_done)
+      continue;
+
+    auto complete{*node.work_done};
+    auto ready{std::ranges::all_of(node.dependencies, [&](size_t dependency) {
+      return nodes[dependency].complete.has_value();
+    })};
+    if (!ready)
+      continue;
+    for (auto dependency : node.dependencies)
+      complete = std::max(complete, *nodes[dependency].complete);
+    node.complete = complete;
+  }
+}
+
+void Scene::report() const {
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  auto path{critical_path(nodes, start)};
+  std::string chain;
+  for (auto node_idx : path.nodes) {
+    const auto &node{nodes[node_idx]};
+    // when the asset's own work was done, relative to the start
+    chain += std::format(
+        "{}{} ({:.1f} ms)",
+        chain.empty() ? "" : " -> ",
+        node.label,
+        Milliseconds{*node.work_done - start}.count()
+    );
+  }
+
+  auto loaded{std::ranges::count_if(nodes, [](const LoadNode &node) {
+    return node.complete.has_value();
+  })};
+  std::println(
+      "Loaded {} of {} assets in {:.1f} ms, critical path: {}",
+      loaded,
+      nodes.size(),
+      Milliseconds{path.length}.count(),
+      chain.empty() ? "none" : chain
+  );
+}
+
+void Scene::refine_meshes() {
+  for (auto &slot : mesh_slots) {
+    if (!slot.stream || !slot.stream->reader)
+      continue;
+
+    if (slot.refine.valid()) {
+      if (!is_ready(slot.refine))
+        continue;
+      // a level that fails to load leaves the mesh at the one it has
+      try {
+        slot.refine.get();
+      } catch (const std::exception &error) {
+        std::println(stderr, "{}", error.what());
+        slot.stream->reader.reset();
+        continue;
+      }
+    }
+
+    // the contents are released once the finest level is uploaded
+    if (slot.stream->complete())
+      slot.stream->reader.reset();
+    else
+      slot.refine = stream_next_level(loader, mesh_arena, *slot.stream);
+  }
+}
+
+bool Scene::update() {
+  auto now{LoadClock::now()};
+  auto rebuilt{false};
+
+  for (size_t shader_idx{0}; shader_idx < shader_slots.size(); ++shader_idx) {
+    auto &slot{shader_slots[shader_idx]};
+    auto &node{nodes[slot.node]};
+    try {
+      if (!slot.reloader.update())
+        continue;
+    } catch (const std::exception &error) {
+      std::println(stderr, "{}", error.what());
+      // a reload that fixes the sources still completes the shader
+      if (!node.work_done)
+        node.failed = true;
+      continue;
+    }
+
+    rebuilt = true;
+    if (!node.work_done) {
+      node.work_done = now;
+      node.failed = false;
+    }
+    if (slot.attribs) {
+      try {
+        check_attribs(slot.shader, node.label, *slot.attribs);
+      } catch (const std::exception &error) {
+        std::println(stderr, "{}", error.what());
+      }
+    }
+    for (auto &mesh : mesh_slots) {
+      if (material_slots[mesh.material].shader == shader_idx)
+        mesh.inputs_match.reset();
+    }
+  }
+
+  for (auto &slot : mesh_slots) {
+    if (slot.stream || !is_ready(slot.load))
+      continue;
+    // get() rethrows failures of either load stage
+    try {
+      slot.stream.emplace(slot.load.get());
+      nodes[slot.node].work_done = now;
+    } catch (const std::exception &error) {
+      std::println(stderr, "{}", error.what());
+      nodes[slot.node].failed = true;
+    }
+  }
+
+  refine_meshes();
+  update_nodes();
+
+  for (auto &slot : mesh_slots) {
+    if (!slot.stream || slot.inputs_match || !nodes[slot.node].complete)
+      continue;
+    const auto &shader{
+        shader_slots[material_slots[slot.material].shader].shader
+    };
+    try {
+      check_vertex_inputs(slot.stream->mesh, shader);
+      slot.inputs_match = true;
+    } catch (const std::exception &error) {
+      std::println(stderr, "{}", error.what());
+      slot.inputs_match = false;
+    }
+  }
+
+  if (!reported) {
+    auto settled{true};
+    for (size_t node_idx{0}; node_idx < nodes.size(); ++node_idx)
+      settled =
+          settled && (nodes[node_idx].complete || blocked(nodes, node_idx));
+    if (settled) {
+      report();
+      reported = true;
+    }
+  }
+
+  return rebuilt;
+}
+
+std::vector<const Shader *> Scene::shaders() const {
+  std::vector<const Shader *> ready;
+  for (const auto &slot : shader_slots) {
+    if (nodes[slot.node].work_done)
+      ready.push_back(&slot.shader);
+  }
+  return ready;
+}
+
+void Scene::draw(StreamRing &commands) const {
+  std::vector<const Mesh *> meshes;
+  for (const auto &slot : mesh_slots) {
+    if (slot.stream && slot.inputs_match == true)
+      meshes.push_back(&slot.stream->mesh);
+  }
+  draw_meshes(meshes, commands);
+}
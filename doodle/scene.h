@@ -0,0 +1,184 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <format>
+#include <future>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assets.h"
+#include "cook_cache.h"
+#include "loader.h"
+#include "mesh.h"
+#include "preprocess.h"
+#include "program_cache.h"
+#include "shader.h"
+#include "stream_ring.h"
+#include "watch.h"
+
+class ManifestError : public std::runtime_error {
+public:
+  explicit ManifestError(const std::string &reason)
+      : std::runtime_error(std::format("Invalid scene manifest: {}", reason)) {}
+};
+
+struct ShaderEntry {
+  std::string name;
+  ShaderStageFiles stages;
+  // vertex inputs the program has to declare, exactly, when given
+  std::optional<std::vector<std::string>> attribs;
+};
+
+struct MaterialEntry {
+  std::string name;
+  std::string shader;
+};
+
+struct MeshEntry {
+  // asset name, as passed to read_mesh
+  std::string name;
+  std::string material;
+};
+
+// Assets of a scene and the dependencies between them, declared in TOML:
+//   [shaders.main]
+//   vertex = "main.vert"      # stage files, default to <name>.vert/.frag
+//   fragment = "main.frag"
+//   attribs = ["a_Pos"]
+//   [materials.main]
+//   shader = "main"
+//   [meshes.triangle]
+//   material = "main"
+struct SceneManifest {
+  std::vector<ShaderEntry> shaders;
+  std::vector<MaterialEntry> materials;
+  std::vector<MeshEntry> meshes;
+};
+
+// Throws ManifestError for malformed TOML, mistyped values and references to
+// assets the manifest does not declare
+SceneManifest
+parse_manifest(std::string_view text, std::string_view source_name);
+
+SceneManifest read_manifest(const AssetLibrary &assets, std::string_view name);
+
+using LoadClock = std::chrono::steady_clock;
+
+// Asset in the load graph of a scene
+// An asset is complete once its own work is done and every dependency is
+// complete. Dependencies always precede their dependents.
+struct LoadNode {
+  std::string label;
+  std::vector<size_t> dependencies;
+  std::optional<LoadClock::time_point> work_done;
+  std::optional<LoadClock::time_point> complete;
+  bool failed{false};
+};
+
+// Chain of assets that bounds when the last one completes
+struct CriticalPath {
+  LoadClock::duration length{};
+  // node indices, from the asset that started the chain to the last one
+  std::vector<size_t> nodes;
+};
+
+// Follows, from the last asset to complete, the dependency each asset waited
+// on for longer than on its own work
+CriticalPath critical_path(
+    std::span<const LoadNode> nodes,
+    LoadClock::time_point start
+);
+
+// Assets of a manifest, loaded concurrently in the background
+// Every read is issued up front, so only dependencies that are actually
+// needed order the loads: a mesh is read while its shader compiles and is
+// only checked against the shader and drawn once both are done. Meshes count
+// as loaded with their coarsest level of detail and are refined a level at a
+// time afterwards. Once everything loaded, the critical path is printed to
+// show what bounds startup.
+class Scene {
+  struct ShaderSlot {
+    Shader shader;
+    ShaderReloader reloader;
+    std::optional<std::vector<std::string>> attribs;
+    size_t node;
+
+    ShaderSlot(
+        const ShaderEntry &entry,
+        size_t node,
+        AssetLoader &loader,
+        ShaderPreprocessor &preprocessor,
+        const ProgramCache &cache
+    );
+  };
+
+  struct MaterialSlot {
+    Material material;
+    size_t shader;
+    size_t node;
+  };
+
+  struct MeshSlot {
+    std::future<MeshStream> load;
+    std::optional<MeshStream> stream;
+    // load of the next level of detail, while the stream is incomplete
+    std::future<void> refine;
+    size_t material;
+    size_t node;
+    // whether the mesh feeds every shader input, checked once per change
+    std::optional<bool> inputs_match;
+  };
+
+  AssetLoader &loader;
+  MeshArena &mesh_arena;
+  LoadClock::time_point start;
+  std::vector<LoadNode> nodes;
+  // deques, materials reference shaders and meshes materials
+  std::deque<ShaderSlot> shader_slots;
+  std::deque<MaterialSlot> material_slots;
+  std::deque<MeshSlot> mesh_slots;
+  bool reported{false};
+
+  void update_nodes();
+  void refine_meshes();
+  void report() const;
+
+public:
+  Scene(
+      const SceneManifest &manifest,
+      const AssetLibrary &assets,
+      AssetLoader &loader,
+      MeshArena &mesh_arena,
+      ShaderPreprocessor &preprocessor,
+      const ProgramCache &program_cache,
+      const CookCache &import_cache
+  );
+  Scene(const Scene &) = delete;
+
+  Scene &operator=(const Scene &) = delete;
+
+  // forwards changed sources to every shader, see
+  // ShaderReloader::request_if_affected()
+  void request_if_affected(std::span<const std::string> sources);
+
+  // watches every file the shaders were last built from
+  void watch_sources(FileWatcher &watcher) const;
+
+  // Advances loads and shader builds, call once per frame on the GL thread
+  // after AssetLoader::pump(). Failures are printed and leave the asset out.
+  // Returns true when a shader got a new program.
+  bool update();
+
+  // shaders that have a program
+  std::vector<const Shader *> shaders() const;
+
+  // draws every mesh whose shader is ready and inputs match, with indirect
+  // commands written into `commands`
+  void draw(StreamRing &commands) const;
+};
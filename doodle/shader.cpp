@@ -0,0 +1,170 @@
+#include "shader.h"
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+
+ShaderStageFiles shader_stage_files(std::string_view name) {
+  return {std::format("{}.frag", name), std::format("{}.vert", name)};
+}
+
+ShaderSources read_shader_sources(
+    ShaderPreprocessor &preprocessor,
+    const ShaderStageFiles &stages
+) {
+  // the preprocessor reads the files here, so the GL thread never waits on
+  // the disk
+  ShaderSources sources{
+      .fragment = preprocessor.preprocess(stages.fragment),
+      .vertex = preprocessor.preprocess(stages.vertex),
+      .hash = 0,
+  };
+
+  // a cache hit then costs the GL thread no source reads, stage hashes are
+  // combined in order so swapping stages changes the key
+  auto stage_hashes{
+      std::to_array({sources.fragment.hash, sources.vertex.hash})
+  };
+  sources.hash = fnv1a(std::as_bytes(std::span{stage_hashes}));
+
+  return sources;
+}
+
+static gl::ProgramBuild
+begin_program_build(const ShaderSources &sources, bool retain_binary) {
+  std::vector<gl::Shader> shaders;
+
+  // fragment shader
+  shaders.emplace_back(GL_FRAGMENT_SHADER);
+  shaders.back().add_source(sources.fragment.chunks);
+
+  // vertex shader
+  shaders.emplace_back(GL_VERTEX_SHADER);
+  shaders.back().add_source(sources.vertex.chunks);
+
+  // compiles and link are issued together, errors surface in finish()
+  return gl::ProgramBuild{std::move(shaders), retain_binary};
+}
+
+static Shader make_shader(gl::Program program) {
+  // reflected once here, draws never query the driver
+  auto layout{reflect_program(program)};
+  return Shader(std::move(program), std::move(layout));
+}
+
+Shader build_shader(const ShaderSources &sources) {
+  return make_shader(begin_program_build(sources, false).finish());
+}
+
+Shader build_shader(const ShaderSources &sources, const ProgramCache &cache) {
+  return finish_shader_build(begin_shader_build(sources, cache), cache);
+}
+
+ShaderBuild
+begin_shader_build(const ShaderSources &sources, const ProgramCache &cache) {
+  std::vector<std::string> files{sources.fragment.files};
+  files.insert(
+      files.end(),
+      sources.vertex.files.begin(),
+      sources.vertex.files.end()
+  );
+
+  // warm starts skip GLSL compilation entirely
+  if (auto program{cache.load(sources.hash)}) {
+    return ShaderBuild{
+        .program = gl::ProgramBuild{std::move(*program)},
+        .hash = sources.hash,
+        .cached = true,
+        .files = std::move(files),
+    };
+  }
+
+  return ShaderBuild{
+      .program = begin_program_build(sources, cache.enabled()),
+      .hash = sources.hash,
+      .cached = false,
+      .files = std::move(files),
+  };
+}
+
+Shader finish_shader_build(ShaderBuild build, const ProgramCache &cache) {
+  auto program{build.program.finish()};
+  if (!build.cached)
+    cache.store(build.hash, program);
+  return make_shader(std::move(program));
+}
+
+Shader load_shader(const AssetLibrary &assets, std::string_view name) {
+  ShaderPreprocessor preprocessor{assets};
+  return build_shader(
+      read_shader_sources(preprocessor, shader_stage_files(name))
+  );
+}
+
+ShaderReloader::ShaderReloader(
+    Shader &shader,
+    ShaderStageFiles stages,
+    AssetLoader &loader,
+    ShaderPreprocessor &preprocessor,
+    const ProgramCache &cache
+)
+    : shader(shader),
+      stages(std::move(stages)),
+      loader(loader),
+      preprocessor(preprocessor),
+      cache(cache) {}
+
+void ShaderReloader::start() {
+  stale = false;
+  load = loader.load(
+      [&preprocessor = preprocessor, stages = stages] {
+        return read_shader_sources(preprocessor, stages);
+      },
+      [&cache = cache](const ShaderSources &sources) {
+        return begin_shader_build(sources, cache);
+      }
+  );
+}
+
+void ShaderReloader::request() {
+  if (load.valid() || build)
+    stale = true;
+  else
+    start();
+}
+
+void ShaderReloader::request_if_affected(std::span<const std::string> sources) {
+  if (std::ranges::any_of(sources, [&](const std::string &source) {
+        return source == stages.fragment || source == stages.vertex;
+      }))
+    request();
+}
+
+bool ShaderReloader::update() {
+  // a failed read throws from get() and leaves no build behind
+  if (load.valid() && is_ready(load)) {
+    build.emplace(load.get());
+    files = build->files;
+  }
+
+  if (!build) {
+    if (stale && !load.valid())
+      start();
+    return false;
+  }
+  if (build->program.status() == gl::BuildStatus::pending)
+    return false;
+
+  auto finished{std::move(*build)};
+  build.reset();
+  // queued before finishing, so a failed build does not drop the next one
+  if (stale)
+    start();
+  shader = finish_shader_build(std::move(finished), cache);
+  return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <future>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assets.h"
+#include "file.h"
+#include "gl.h"
+#include "loader.h"
+#include "preprocess.h"
+#include "program_cache.h"
+#include "reflect.h"
+#include "vertex.h"
+
+// Abstract shader representation
+// Contains input declarations for attributes and uniforms, reflected from the
+// program once it is built.
+// Uniforms get populated by instantiating a Material referencing this Shader,
+// and vertex attributes gets populated by a Mesh.
+struct Shader {
+  gl::Program program;
+  ProgramLayout layout;
+};
+
+struct Material {
+  // should be a handle to shader instance but this works for now
+  const Shader &shader;
+  // TODO: Uniform bindings
+};
+
+// Stage sources of a shader program with their includes resolved
+struct ShaderSources {
+  PreprocessedSource fragment;
+  PreprocessedSource vertex;
+  // fnv1a over every stage, keys the program cache
+  uint64_t hash{0};
+};
+
+// asset names of the stages of a shader program
+struct ShaderStageFiles {
+  std::string fragment;
+  std::string vertex;
+};
+
+// stages named after the shader, <name>.frag and <name>.vert
+ShaderStageFiles shader_stage_files(std::string_view name);
+
+// Reads and preprocesses shader sources, safe to call off the GL thread
+ShaderSources read_shader_sources(
+    ShaderPreprocessor &preprocessor,
+    const ShaderStageFiles &stages
+);
+
+// Compiles and links a program from its sources on the GL thread
+Shader build_shader(const ShaderSources &sources);
+
+// Loads the program from the cache, compiling and storing it on a miss
+Shader build_shader(const ShaderSources &sources, const ProgramCache &cache);
+
+// Shader program the driver is still building, see gl::ProgramBuild
+struct ShaderBuild {
+  gl::ProgramBuild program;
+  // key of the sources, a fresh program is stored under it once finished
+  uint64_t hash{0};
+  bool cached{false};
+  // files of every stage including their includes
+  std::vector<std::string> files;
+};
+
+// Issues the build on the GL thread without waiting for the driver, or takes
+// the program from the cache when it holds one
+ShaderBuild
+begin_shader_build(const ShaderSources &sources, const ProgramCache &cache);
+
+// Completes a build, best once its status is no longer pending, and stores a
+// fresh program in the cache
+// Throws CompilationError or LinkError when the build failed.
+Shader finish_shader_build(ShaderBuild build, const ProgramCache &cache);
+
+// Loads a shader from disk
+// should be properly handled by an asset loader
+Shader load_shader(const AssetLibrary &assets, std::string_view name);
+
+// Builds a shader's program in the background and swaps it in between frames
+// Sources are read on loader threads and compiled by the driver's threads,
+// update() only polls, so neither the first load nor a reload stalls a frame.
+// A build that fails leaves the previous program in place.
+class ShaderReloader {
+  Shader &shader;
+  ShaderStageFiles stages;
+  AssetLoader &loader;
+  ShaderPreprocessor &preprocessor;
+  const ProgramCache &cache;
+
+  std::future<ShaderBuild> load;
+  std::optional<ShaderBuild> build;
+  std::vector<std::string> files;
+  // sources changed while a build was running
+  bool stale{false};
+
+  void start();
+
+public:
+  ShaderReloader(
+      Shader &shader,
+      ShaderStageFiles stages,
+      AssetLoader &loader,
+      ShaderPreprocessor &preprocessor,
+      const ProgramCache &cache
+  );
+
+  // starts a build, or queues one behind the build that is running
+  void request();
+
+  // requests a build when one of the changed `sources` is a stage of the
+  // shader, see ShaderPreprocessor::invalidate()
+  void request_if_affected(std::span<const std::string> sources);
+
+  // every file the last build read, includes are only known once it did
+  const std::vector<std::string> &source_files() const { return files; }
+
+  // Advances the running build, call once per frame on the GL thread
+  // Returns true when the shader got a new program. Throws the error of a
+  // failed build, the shader keeps its program.
+  bool update();
+};
@@ -0,0 +1,174 @@
+#include "staging.h"
+
+#include <algorithm>
+#include <format>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+// keeps slices suitable for wide copies in and out of them
+constexpr size_t slice_alignment{16};
+
+StagingSlice::StagingSlice(StagingQueue &queue, size_t offset, size_t size)
+    : queue(&queue), start(offset), length(size) {}
+
+StagingSlice::StagingSlice(StagingSlice &&other) noexcept
+    : queue(std::exchange(other.queue, nullptr)), start(other.start),
+      length(other.length) {}
+
+StagingSlice::~StagingSlice() {
+  if (queue)
+    queue->release(start, length);
+}
+
+StagingSlice &StagingSlice::operator=(StagingSlice &&other) noexcept {
+  // release this object's range
+  if (queue)
+    queue->release(start, length);
+
+  // move the range out of other into this
+  queue = std::exchange(other.queue, nullptr);
+  start = other.start;
+  length = other.length;
+
+  return *this;
+}
+
+std::span<std::byte> StagingSlice::bytes() const {
+  if (!queue)
+    return {};
+  return {queue->mapping + start, length};
+}
+
+StagingQueue::StagingQueue(size_t capacity, size_t frame_budget)
+    : capacity(capacity), frame_budget(frame_budget), allocator(capacity) {
+  // coherent, so writes through the mapping are visible to copies issued
+  // after them without explicit flushes
+  constexpr GLbitfield flags{
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT
+  };
+  buffer.allocate_storage(nullptr, capacity, flags);
+  mapping = buffer.map_range<std::byte>(0, capacity, flags).data();
+}
+
+StagingSlice StagingQueue::reserve(size_t size) {
+  // empty slices still get a distinct offset
+  size = std::max<size_t>(size, 1);
+  if (size > capacity) {
+    throw std::runtime_error(std::format(
+        "Staging buffer of {} bytes cannot hold {} bytes",
+        capacity,
+        size
+    ));
+  }
+
+  std::unique_lock lock{mutex};
+  std::optional<size_t> offset;
+  space_freed.wait(lock, [&] {
+    return closed ||
+           (offset = allocator.allocate(size, slice_alignment)).has_value();
+  });
+  if (closed)
+    throw std::runtime_error("Staging queue was closed");
+
+  return StagingSlice{*this, *offset, size};
+}
+
+void StagingQueue::copy(
+    const StagingSlice &slice,
+    size_t offset,
+    GLuint destination,
+    size_t destination_offset,
+    size_t size
+) {
+  if (size == 0)
+    return;
+
+  std::lock_guard lock{mutex};
+  steps.push_back(Copy{
+      .source = slice.offset() + offset,
+      .destination = destination,
+      .offset = destination_offset,
+      .size = size,
+  });
+  ++copy_count;
+}
+
+void StagingQueue::then(Callback done) {
+  std::lock_guard lock{mutex};
+  steps.push_back(std::move(done));
+}
+
+void StagingQueue::release(size_t offset, size_t size) {
+  std::lock_guard lock{mutex};
+  steps.push_back(Release{.offset = offset, .size = size});
+}
+
+size_t StagingQueue::flush() {
+  size_t copied{0};
+  std::vector<Release> released;
+  while (true) {
+    std::unique_lock lock{mutex};
+    if (steps.empty())
+      break;
+
+    auto &step{steps.front()};
+    if (auto *copy{std::get_if<Copy>(&step)}) {
+      // the rest of a copy larger than the remaining budget is issued by
+      // the next flush
+      auto size{std::min(copy->size, frame_budget - copied)};
+      if (size == 0)
+        break;
+
+      glCopyNamedBufferSubData(
+          buffer,
+          copy->destination,
+          static_cast<GLintptr>(copy->source),
+          static_cast<GLintptr>(copy->offset),
+          static_cast<GLsizeiptr>(size)
+      );
+      copied += size;
+      copy->source += size;
+      copy->offset += size;
+      copy->size -= size;
+      if (copy->size == 0)
+        steps.pop_front();
+    } else if (auto *release{std::get_if<Release>(&step)}) {
+      released.push_back(*release);
+      steps.pop_front();
+    } else {
+      // callbacks may enqueue more work
+      auto done{std::move(std::get<Callback>(step))};
+      steps.pop_front();
+      lock.unlock();
+      done();
+    }
+  }
+
+  if (!released.empty()) {
+    auto &entry{retired.emplace_back()};
+    entry.fence.insert();
+    entry.ranges = std::move(released);
+  }
+
+  bool recycled{false};
+  while (!retired.empty() && retired.front().fence.signaled()) {
+    std::lock_guard lock{mutex};
+    for (const auto &range : retired.front().ranges)
+      allocator.free(range.offset, range.size);
+    retired.pop_front();
+    recycled = true;
+  }
+  if (recycled)
+    space_freed.notify_all();
+
+  return copied;
+}
+
+void StagingQueue::close() {
+  {
+    std::lock_guard lock{mutex};
+    closed = true;
+  }
+  space_freed.notify_all();
+}
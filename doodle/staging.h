@@ -0,0 +1,130 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include "arena.h"
+#include "gl.h"
+
+class StagingQueue;
+
+// Range of a StagingQueue's buffer, filled through the mapping by the thread
+// that reserved it
+// Destroying the slice releases the range, which is recycled once the copies
+// enqueued from it before have completed on the GPU.
+class StagingSlice {
+  StagingQueue *queue{nullptr};
+  size_t start{0};
+  size_t length{0};
+
+public:
+  StagingSlice() = default;
+  StagingSlice(StagingQueue &queue, size_t offset, size_t size);
+  StagingSlice(const StagingSlice &) = delete;
+  StagingSlice(StagingSlice &&other) noexcept;
+  ~StagingSlice();
+
+  StagingSlice &operator=(const StagingSlice &) = delete;
+  StagingSlice &operator=(StagingSlice &&other) noexcept;
+
+  std::span<std::byte> bytes() const;
+
+  // from the start of the staging buffer
+  size_t offset() const { return start; }
+  size_t size() const { return length; }
+};
+
+// Persistently mapped buffer that loader threads fill and the GL thread
+// copies into other buffers
+// Slices are reserved and written on any thread. Copies out of them are
+// enqueued on the GL thread and issued by flush() with
+// glCopyNamedBufferSubData, at most `frame_budget` bytes per call, so
+// streaming large assets spreads their transfers over several frames instead
+// of stalling one. Released slices are fenced after their last copy and
+// reused once the fence signals.
+class StagingQueue {
+  struct Copy {
+    size_t source;
+    GLuint destination;
+    size_t offset;
+    size_t size;
+  };
+
+  struct Release {
+    size_t offset;
+    size_t size;
+  };
+
+  using Callback = std::move_only_function<void()>;
+  using Step = std::variant<Copy, Release, Callback>;
+
+  // ranges whose last copy was issued before the fence
+  struct Retired {
+    gl::Fence fence;
+    std::vector<Release> ranges;
+  };
+
+  gl::Buffer buffer;
+  std::byte *mapping{nullptr};
+  size_t capacity;
+  size_t frame_budget;
+  std::mutex mutex;
+  std::condition_variable space_freed;
+  RangeAllocator allocator;
+  // copies, releases and callbacks in the order they were enqueued
+  std::deque<Step> steps;
+  std::deque<Retired> retired;
+  uint64_t copy_count{0};
+  bool closed{false};
+
+  friend class StagingSlice;
+
+  void release(size_t offset, size_t size);
+
+public:
+  StagingQueue(size_t capacity, size_t frame_budget);
+  StagingQueue(const StagingQueue &) = delete;
+
+  StagingQueue &operator=(const StagingQueue &) = delete;
+
+  // Reserves `size` bytes, waiting while the buffer has no room for them,
+  // safe to call from any thread
+  // Throws std::runtime_error when `size` exceeds the capacity or the queue
+  // has been closed.
+  StagingSlice reserve(size_t size);
+
+  // enqueues a copy of `size` bytes at `offset` in the slice into
+  // `destination` at `destination_offset`, GL thread only
+  void copy(
+      const StagingSlice &slice,
+      size_t offset,
+      GLuint destination,
+      size_t destination_offset,
+      size_t size
+  );
+
+  // runs `done` on the GL thread during the flush() that issues the last
+  // copy enqueued before it, GL thread only
+  void then(Callback done);
+
+  // Issues queued copies up to the frame budget, runs the callbacks they
+  // were holding back and recycles slices whose copies completed
+  // Call once per frame on the GL thread. Returns the number of bytes copied.
+  size_t flush();
+
+  // wakes threads waiting for room and rejects further reservations
+  void close();
+
+  // copies enqueued so far, to tell whether a piece of work staged anything
+  uint64_t copies() const { return copy_count; }
+
+  // bytes of the buffer, no slice is larger
+  size_t size() const { return capacity; }
+};
@@ -0,0 +1,65 @@
+#include "stream_ring.h"
+
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+static size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+StreamRing::StreamRing(
+    size_t region_size,
+    size_t alignment,
+    size_t frames_in_flight
+)
+    : region_size(align_up(region_size, alignment)), alignment(alignment),
+      fences(frames_in_flight) {
+  // coherent, so writes are visible to commands issued after them without
+  // explicit flushes
+  constexpr GLbitfield flags{
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT
+  };
+  auto size{this->region_size * frames_in_flight};
+  buffer.allocate_storage(nullptr, size, flags);
+  mapping = buffer.map_range<std::byte>(0, size, flags).data();
+}
+
+void StreamRing::begin_frame() { fences[region].wait(); }
+
+RingSlice StreamRing::allocate(size_t size) {
+  auto offset{align_up(used, alignment)};
+  if (offset + size > region_size) {
+    throw std::runtime_error(std::format(
+        "Stream ring region of {} bytes exhausted by {} more",
+        region_size,
+        size
+    ));
+  }
+  used = offset + size;
+
+  auto start{region * region_size + offset};
+  return RingSlice{
+      .buffer = buffer,
+      .offset = start,
+      .bytes = {mapping + start, size},
+  };
+}
+
+RingSlice StreamRing::write(std::span<const std::byte> data) {
+  auto slice{allocate(data.size())};
+  std::memcpy(slice.bytes.data(), data.data(), data.size());
+  return slice;
+}
+
+void StreamRing::end_frame() {
+  fences[region].insert();
+  region = (region + 1) % fences.size();
+  used = 0;
+}
+
+size_t uniform_buffer_alignment() {
+  GLint alignment;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  return static_cast<size_t>(alignment);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "gl.h"
+
+// Part of a StreamRing, written through the mapping and read by the GPU in
+// the frame it was allocated in
+struct RingSlice {
+  GLuint buffer;
+  // from the start of the buffer, as passed to glBindBufferRange
+  size_t offset;
+  std::span<std::byte> bytes;
+};
+
+// Persistently mapped, coherent buffer for data written every frame
+// The buffer is split into one region per frame in flight. A frame writes
+// its region with plain copies and binds slices of it by offset; before a
+// region is reused, begin_frame() waits on the fence end_frame() inserted
+// after its last use. The storage is never respecified, so writes neither
+// reallocate nor synchronize implicitly with draws still reading.
+class StreamRing {
+  gl::Buffer buffer;
+  std::byte *mapping{nullptr};
+  size_t region_size;
+  size_t alignment;
+  std::vector<gl::Fence> fences;
+  size_t region{0};
+  size_t used{0};
+
+public:
+  // `alignment` is the offset alignment of the bindings slices are used
+  // with, see uniform_buffer_alignment()
+  StreamRing(size_t region_size, size_t alignment, size_t frames_in_flight = 3);
+  StreamRing(const StreamRing &) = delete;
+
+  StreamRing &operator=(const StreamRing &) = delete;
+
+  // waits until the GPU is done with the region of this frame
+  void begin_frame();
+
+  // Reserves `size` bytes of the current region, to be filled by the caller
+  // Throws std::runtime_error when the region is exhausted.
+  RingSlice allocate(size_t size);
+
+  // allocates a slice holding a copy of `data`
+  RingSlice write(std::span<const std::byte> data);
+
+  // fences the region of this frame and moves on to the next one, call
+  // after the last command reading the frame's slices
+  void end_frame();
+
+  size_t capacity() const { return region_size; }
+};
+
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+size_t uniform_buffer_alignment();
@@ -0,0 +1,228 @@
+#include "vertex.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+uint16_t float_to_half(float value) {
+  auto bits{std::bit_cast<uint32_t>(value)};
+  auto sign{(bits >> 16) & 0x8000};
+  auto float_exponent{static_cast<int32_t>((bits >> 23) & 0xff)};
+  auto mantissa{bits & 0x7fffff};
+
+  // infinity and NaN keep their class
+  if (float_exponent == 0xff)
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+  auto exponent{float_exponent - 127 + 15};
+  if (exponent >= 31)
+    return static_cast<uint16_t>(sign | 0x7c00);
+
+  if (exponent <= 0) {
+    // too small even for a subnormal half
+    if (exponent < -10)
+      return static_cast<uint16_t>(sign);
+
+    // subnormal, shift the mantissa including its implicit bit into place
+    mantissa |= 0x800000;
+    auto shift{static_cast<uint32_t>(14 - exponent)};
+    auto half_mantissa{mantissa >> shift};
+    auto remainder{mantissa & ((1u << shift) - 1)};
+    auto halfway{1u << (shift - 1)};
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+      ++half_mantissa;
+    return static_cast<uint16_t>(sign | half_mantissa);
+  }
+
+  // round to nearest even, a carry correctly rolls over into the exponent
+  auto half{sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13)};
+  auto remainder{mantissa & 0x1fff};
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    ++half;
+  return static_cast<uint16_t>(half);
+}
+
+float half_to_float(uint16_t value) {
+  auto sign{static_cast<uint32_t>(value & 0x8000) << 16};
+  auto exponent{static_cast<uint32_t>(value >> 10) & 0x1f};
+  auto mantissa{static_cast<uint32_t>(value) & 0x3ff};
+
+  if (exponent == 0) {
+    auto magnitude{std::ldexp(static_cast<float>(mantissa), -24)};
+    return sign ? -magnitude : magnitude;
+  }
+  if (exponent == 31)
+    return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+
+  return std::bit_cast<float>(
+      sign | ((exponent + 112) << 23) | (mantissa << 13)
+  );
+}
+
+template <typename T>
+static T load(const std::byte *data, size_t component) {
+  T value;
+  std::memcpy(&value, data + component * sizeof(T), sizeof(T));
+  return value;
+}
+
+template <typename T>
+static void store(std::byte *data, size_t component, T value) {
+  std::memcpy(data + component * sizeof(T), &value, sizeof(T));
+}
+
+// sign extends the low `bits` bits of a packed field
+static int32_t sign_extend(uint32_t value, int bits) {
+  auto shift{32 - bits};
+  return static_cast<int32_t>(value << shift) >> shift;
+}
+
+std::array<float, 4>
+decode_attrib(const std::byte *data, const VertexAttrib &attrib) {
+  std::array<float, 4> value{};
+  auto normalized{attrib.normalized};
+
+  if (is_packed(attrib.props.type)) {
+    auto packed{load<uint32_t>(data, 0)};
+    std::array<uint32_t, 4> fields{
+        packed & 0x3ff,
+        (packed >> 10) & 0x3ff,
+        (packed >> 20) & 0x3ff,
+        packed >> 30,
+    };
+
+    for (size_t component{0}; component < 4; ++component) {
+      auto bits{component == 3 ? 2 : 10};
+      if (attrib.props.type == AttribType::i10_10_10_2) {
+        auto raw{static_cast<float>(sign_extend(fields[component], bits))};
+        auto max{static_cast<float>((1 << (bits - 1)) - 1)};
+        value[component] = normalized ? std::max(raw / max, -1.0f) : raw;
+      } else {
+        auto raw{static_cast<float>(fields[component])};
+        auto max{static_cast<float>((1 << bits) - 1)};
+        value[component] = normalized ? raw / max : raw;
+      }
+    }
+    return value;
+  }
+
+  auto components{std::min<size_t>(attrib.props.size, 4)};
+  for (size_t component{0}; component < components; ++component) {
+    float &out{value[component]};
+    switch (attrib.props.type) {
+    case AttribType::f16:
+      out = half_to_float(load<uint16_t>(data, component));
+      break;
+    case AttribType::f32:
+      out = load<float>(data, component);
+      break;
+    case AttribType::f64:
+      out = static_cast<float>(load<double>(data, component));
+      break;
+    case AttribType::i8: {
+      auto raw{static_cast<float>(load<int8_t>(data, component))};
+      out = normalized ? std::max(raw / 127.0f, -1.0f) : raw;
+      break;
+    }
+    case AttribType::u8: {
+      auto raw{static_cast<float>(load<uint8_t>(data, component))};
+      out = normalized ? raw / 255.0f : raw;
+      break;
+    }
+    case AttribType::i16: {
+      auto raw{static_cast<float>(load<int16_t>(data, component))};
+      out = normalized ? std::max(raw / 32767.0f, -1.0f) : raw;
+      break;
+    }
+    case AttribType::u16: {
+      auto raw{static_cast<float>(load<uint16_t>(data, component))};
+      out = normalized ? raw / 65535.0f : raw;
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  return value;
+}
+
+// rounds a float into an integer range, scaling it first when normalized
+template <typename T>
+static T quantize(float value, bool normalized, float min, float max) {
+  auto scale{normalized ? max : 1.0f};
+  auto clamped{std::clamp(value * scale, min, max)};
+  return static_cast<T>(std::lround(clamped));
+}
+
+// signed integers use their whole range, except the most negative value when
+// normalized, which would decode below -1
+template <typename T>
+static T quantize_signed(float value, bool normalized) {
+  auto max{static_cast<float>(std::numeric_limits<T>::max())};
+  auto min{normalized ? -max : -max - 1};
+  return quantize<T>(value, normalized, min, max);
+}
+
+void encode_attrib(
+    std::byte *data,
+    const VertexAttrib &attrib,
+    const std::array<float, 4> &value
+) {
+  auto normalized{attrib.normalized};
+
+  if (is_packed(attrib.props.type)) {
+    uint32_t packed{0};
+    for (size_t component{0}; component < 4; ++component) {
+      auto bits{component == 3 ? 2 : 10};
+      auto mask{(1u << bits) - 1};
+
+      uint32_t field;
+      if (attrib.props.type == AttribType::i10_10_10_2) {
+        auto max{static_cast<float>((1 << (bits - 1)) - 1)};
+        auto min{normalized ? -max : -max - 1};
+        field = static_cast<uint32_t>(
+                    quantize<int32_t>(value[component], normalized, min, max)
+                ) &
+                mask;
+      } else {
+        auto max{static_cast<float>(mask)};
+        field = quantize<uint32_t>(value[component], normalized, 0.0f, max);
+      }
+      packed |= field << (component * 10);
+    }
+    store(data, 0, packed);
+    return;
+  }
+
+  auto components{std::min<size_t>(attrib.props.size, 4)};
+  for (size_t component{0}; component < components; ++component) {
+    auto in{value[component]};
+    switch (attrib.props.type) {
+    case AttribType::f16:
+      store(data, component, float_to_half(in));
+      break;
+    case AttribType::f32:
+      store(data, component, in);
+      break;
+    case AttribType::f64:
+      store(data, component, static_cast<double>(in));
+      break;
+    case AttribType::i8:
+      store(data, component, quantize_signed<int8_t>(in, normalized));
+      break;
+    case AttribType::u8:
+      store(data, component, quantize<uint8_t>(in, normalized, 0, 255));
+      break;
+    case AttribType::i16:
+      store(data, component, quantize_signed<int16_t>(in, normalized));
+      break;
+    case AttribType::u16:
+      store(data, component, quantize<uint16_t>(in, normalized, 0, 65535));
+      break;
+    default:
+      break;
+    }
+  }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/gl.h>
+
+enum class AttribLocation : GLuint {
+  position = 0,
+  normal = 1,
+  texcoord = 2,
+};
+
+// Integer types are read as floats, scaled to [0, 1] (unsigned) or [-1, 1]
+// (signed) when VertexAttrib::normalized is set. Packed types hold four
+// components in 32 bits and require a size of 4.
+enum class AttribType : GLenum {
+  f16 = GL_HALF_FLOAT,
+  f32 = GL_FLOAT,
+  f64 = GL_DOUBLE,
+  i8 = GL_BYTE,
+  u8 = GL_UNSIGNED_BYTE,
+  i16 = GL_SHORT,
+  u16 = GL_UNSIGNED_SHORT,
+  i10_10_10_2 = GL_INT_2_10_10_10_REV,
+  u10_10_10_2 = GL_UNSIGNED_INT_2_10_10_10_REV,
+};
+
+enum class IndexType : GLenum {
+  u8 = GL_UNSIGNED_BYTE,
+  u16 = GL_UNSIGNED_SHORT,
+  u32 = GL_UNSIGNED_INT,
+};
+
+enum class Primitive : GLenum {
+  triangles = GL_TRIANGLES,
+  // strips are separated by the largest value of the index type, see
+  // restart_index
+  triangle_strip = GL_TRIANGLE_STRIP,
+};
+
+struct VertexAttribProps {
+  AttribLocation location;
+  AttribType type;
+  size_t size;
+
+  bool operator==(const VertexAttribProps &) const = default;
+};
+
+struct VertexAttrib {
+  VertexAttribProps props;
+  size_t offset;
+  bool normalized;
+
+  bool operator==(const VertexAttrib &) const = default;
+};
+
+struct VertexFormat {
+  std::vector<VertexAttrib> attribs;
+  size_t stride;
+
+  bool operator==(const VertexFormat &) const = default;
+};
+
+constexpr bool is_packed(AttribType type) {
+  return type == AttribType::i10_10_10_2 || type == AttribType::u10_10_10_2;
+}
+
+// size in bytes of a single attribute value
+constexpr size_t attrib_size(const VertexAttribProps &props) {
+  switch (props.type) {
+  case AttribType::i8:
+  case AttribType::u8:
+    return props.size;
+  case AttribType::f16:
+  case AttribType::i16:
+  case AttribType::u16:
+    return props.size * 2;
+  case AttribType::f64:
+    return props.size * 8;
+  case AttribType::i10_10_10_2:
+  case AttribType::u10_10_10_2:
+    return 4;
+  default:
+    return props.size * 4;
+  }
+}
+
+// bytes a stream of `count` vertices occupies, the last vertex only needs to
+// reach the end of its furthest attribute rather than a full stride
+inline size_t stream_size(const VertexFormat &format, size_t count) {
+  if (count == 0)
+    return 0;
+
+  size_t vertex_end{0};
+  for (const auto &attrib : format.attribs)
+    vertex_end =
+        std::max(vertex_end, attrib.offset + attrib_size(attrib.props));
+  return (count - 1) * format.stride + vertex_end;
+}
+
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+
+// Reads one attribute value as floats, following the conversion rules GL
+// applies for glVertexArrayAttribFormat. Missing components read as zero.
+std::array<float, 4>
+decode_attrib(const std::byte *data, const VertexAttrib &attrib);
+
+// Writes one attribute value, rounding to nearest and clamping to the range
+// the type can represent
+void encode_attrib(
+    std::byte *data,
+    const VertexAttrib &attrib,
+    const std::array<float, 4> &value
+);
+
+// size in bytes of a single index
+constexpr size_t index_size(IndexType type) {
+  switch (type) {
+  case IndexType::u8:
+    return 1;
+  case IndexType::u16:
+    return 2;
+  default:
+    return 4;
+  }
+}
+
+// the primitive restart index, GL_PRIMITIVE_RESTART_FIXED_INDEX uses the
+// largest value of the index type
+constexpr uint32_t restart_index(IndexType type) {
+  switch (type) {
+  case IndexType::u8:
+    return 0xff;
+  case IndexType::u16:
+    return 0xffff;
+  default:
+    return 0xffffffff;
+  }
+}
+
+// narrowest index type able to address `vertex_count` vertices, keeping the
+// restart index free when `primitive_restart` is set
+// Never u8, many drivers convert it on the CPU or emulate it in the shader.
+constexpr IndexType
+narrowest_index_type(size_t vertex_count, bool primitive_restart = false) {
+  auto limit{primitive_restart ? size_t{0xffff} : size_t{0x10000}};
+  return vertex_count <= limit ? IndexType::u16 : IndexType::u32;
+}
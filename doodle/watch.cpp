@@ -0,0 +1,98 @@
+#include "watch.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// the key a file is known by, the same for every spelling of its path
+static std::string file_key(const fs::path &directory, const fs::path &name) {
+  return (directory / name).lexically_normal().string();
+}
+
+static fs::path directory_of(const fs::path &file) {
+  auto directory{file.parent_path()};
+  return directory.empty() ? fs::path{"."} : directory;
+}
+
+FileWatcher::FileWatcher() : fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+  if (fd < 0) {
+    throw std::runtime_error(
+        std::format("Failed to create file watcher: {}", std::strerror(errno))
+    );
+  }
+}
+
+FileWatcher::~FileWatcher() { close(fd); }
+
+void FileWatcher::watch(const fs::path &file) {
+  auto directory{directory_of(file)};
+  auto key{file_key(directory, file.filename())};
+  if (files.contains(key))
+    return;
+
+  auto descriptor{inotify_add_watch(
+      fd,
+      directory.c_str(),
+      IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE
+  )};
+  if (descriptor < 0) {
+    throw std::runtime_error(std::format(
+        "Failed to watch {}: {}",
+        directory.string(),
+        std::strerror(errno)
+    ));
+  }
+
+  // the kernel hands out one descriptor per directory
+  directories.try_emplace(descriptor, directory);
+  files.insert(std::move(key));
+}
+
+std::vector<fs::path> FileWatcher::poll() {
+  std::vector<fs::path> changed;
+  bool overflowed{false};
+
+  alignas(inotify_event) std::array<char, 4096> buffer;
+  while (true) {
+    auto length{read(fd, buffer.data(), buffer.size())};
+    if (length <= 0) {
+      // EAGAIN once the queue is drained, nothing else is recoverable here
+      break;
+    }
+
+    for (ssize_t offset{0}; offset < length;) {
+      inotify_event event;
+      std::memcpy(&event, buffer.data() + offset, sizeof(event));
+      auto name{buffer.data() + offset + sizeof(event)};
+      offset += static_cast<ssize_t>(sizeof(event) + event.len);
+
+      // the kernel dropped events, any watched file may have changed
+      if (event.mask & IN_Q_OVERFLOW) {
+        overflowed = true;
+        continue;
+      }
+
+      auto directory{directories.find(event.wd)};
+      if (event.len == 0 || directory == directories.end())
+        continue;
+
+      // a save usually raises several events, report the file once
+      fs::path key{file_key(directory->second, name)};
+      if (files.contains(key.string()) &&
+          std::ranges::find(changed, key) == changed.end())
+        changed.emplace_back(key);
+    }
+  }
+
+  if (overflowed)
+    changed.assign(files.begin(), files.end());
+  return changed;
+}
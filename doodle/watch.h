@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Non-blocking notification of changes to a set of files, backed by inotify
+// Watches the directories holding the files rather than the files, as editors
+// commonly save by writing a new file and renaming it over the old one.
+class FileWatcher {
+  int fd{-1};
+  // watch descriptor to directory
+  std::unordered_map<int, std::filesystem::path> directories;
+  std::unordered_set<std::string> files;
+
+public:
+  FileWatcher();
+  FileWatcher(const FileWatcher &) = delete;
+  ~FileWatcher();
+
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  // cheap for files that are already watched
+  void watch(const std::filesystem::path &file);
+
+  // returns the watched files written or replaced since the last call, each
+  // once, without blocking; all of them when the kernel dropped events
+  std::vector<std::filesystem::path> poll();
+};
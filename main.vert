@@ -1,9 +1,7 @@
 #version 440 core
 layout (location = 0) in vec3 a_Pos; // the position variable has attribute position 0
 
-layout (std140, binding = 0) uniform Matrices {
-    mat4 u_ProjView;
-};
+#include "matrices.glsl"
 
 out vec4 vertexColor; // specify a color output to the fragment shader
 
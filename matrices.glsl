@@ -0,0 +1,4 @@
+// camera matrices, bound at uniform buffer binding 0
+layout (std140, binding = 0) uniform Matrices {
+    mat4 u_ProjView;
+};